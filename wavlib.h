@@ -5,11 +5,56 @@
 #include <fstream>
 #include <vector>
 #include <cstring>
+#include <cstdio>
 #include <cstdint>
+#include <cstdlib>
+#include <cerrno>
 #include <string>
 #include <cmath>
 #include <limits>
 #include <type_traits>
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <complex>
+#include <random>
+#include <sstream>
+#include <filesystem>
+#include <chrono>
+#include <list>
+#include <unordered_map>
+#include <functional>
+#include <array>
+#include <map>
+#include <numeric>
+#include <tuple>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define WAVLIB_POSIX 1
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <limits.h>
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#include <sys/inotify.h>
+#include <poll.h>
+#endif
+#endif
+
+// Batch loading uses io_uring through the raw system calls, so only the
+// kernel headers are needed. Define WAVLIB_NO_IO_URING to use threads only.
+#if defined(WAVLIB_POSIX) && defined(__linux__) && !defined(WAVLIB_NO_IO_URING) && __has_include(<linux/io_uring.h>)
+#define WAVLIB_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif
 
 namespace wav
 {
@@ -54,9 +99,9 @@ namespace wav
   */
 
   //------------------------------------------------------------------------------
-  // WavFile: Represents a complete WAV file (header and interleaved raw audio data).
+  // WavInfo: Header metadata of a WAV file, including where its samples start.
   //------------------------------------------------------------------------------
-  struct WavFile
+  struct WavInfo
   {
     uint32_t chunk_size = 0;
     uint16_t num_channels = 0;
@@ -65,23 +110,21 @@ namespace wav
     uint16_t bits_per_sample = 0;
     uint32_t data_size = 0;
     uint32_t num_samples = 0; // per channel
-    std::vector<char> raw_data;
+    uint64_t data_offset = 0; // byte offset of the first sample in the file
 
-    // Reads a WAV file from disk.
-    bool read(const std::string &filePath)
+    // Walks the RIFF chunks of a seekable stream up to the "data" subchunk,
+    // leaving the stream positioned at the first sample. quiet suppresses the
+    // error messages.
+    bool read(std::istream &file, bool quiet = false)
     {
-      std::ifstream file(filePath, std::ios::binary);
-      if (!file.is_open())
-      {
-        std::cerr << "Couldn't open file: " << filePath << std::endl;
-        return false;
-      }
+      std::streamoff start = file.tellg();
       // Read RIFF header.
       char chunkID[5] = {0};
       file.read(chunkID, 4);
       if (std::strncmp(chunkID, "RIFF", 4) != 0)
       {
-        std::cerr << "ChunkID must be 'RIFF'" << std::endl;
+        if (!quiet)
+          std::cerr << "ChunkID must be 'RIFF'" << std::endl;
         return false;
       }
       file.read(reinterpret_cast<char *>(&chunk_size), sizeof(chunk_size));
@@ -89,7 +132,8 @@ namespace wav
       file.read(format, 4);
       if (std::strncmp(format, "WAVE", 4) != 0)
       {
-        std::cerr << "Format must be 'WAVE'" << std::endl;
+        if (!quiet)
+          std::cerr << "Format must be 'WAVE'" << std::endl;
         return false;
       }
       // Read subchunks until both "fmt " and "data" are found.
@@ -119,8 +163,10 @@ namespace wav
         {
           foundData = true;
           data_size = subchunk_size;
-          raw_data.resize(data_size);
-          file.read(raw_data.data(), data_size);
+          data_offset = static_cast<uint64_t>(file.tellg() - start);
+          // Keep looking if "fmt " comes after the samples.
+          if (!foundFmt)
+            file.seekg(subchunk_size, std::ios::cur);
         }
         else
         {
@@ -129,225 +175,5841 @@ namespace wav
       }
       if (!foundFmt)
       {
-        std::cerr << "Couldn't find 'fmt ' subchunk." << std::endl;
+        if (!quiet)
+          std::cerr << "Couldn't find 'fmt ' subchunk." << std::endl;
         return false;
       }
       if (!foundData)
       {
-        std::cerr << "Couldn't find 'data' subchunk." << std::endl;
+        if (!quiet)
+          std::cerr << "Couldn't find 'data' subchunk." << std::endl;
+        return false;
+      }
+      if (block_align == 0)
+      {
+        if (!quiet)
+          std::cerr << "BlockAlign must not be 0." << std::endl;
         return false;
       }
+      file.clear();
+      file.seekg(start + static_cast<std::streamoff>(data_offset));
       num_samples = data_size / block_align;
       return true;
     }
 
-    // Saves this WAV file to disk.
-    bool save(const std::string &filePath) const
+    // Same as read(), for a file already in memory.
+    bool parse(const char *data, size_t size)
     {
-      std::ofstream out(filePath, std::ios::binary);
-      if (!out.is_open())
+      if (size < 12 || std::strncmp(data, "RIFF", 4) != 0)
       {
-        std::cerr << "Error opening output file: " << filePath << std::endl;
+        std::cerr << "ChunkID must be 'RIFF'" << std::endl;
         return false;
       }
-      out.write("RIFF", 4);
-      out.write(reinterpret_cast<const char *>(&chunk_size), sizeof(chunk_size));
-      out.write("WAVE", 4);
-      out.write("fmt ", 4);
-      uint32_t subchunk1Size = 16;
-      out.write(reinterpret_cast<const char *>(&subchunk1Size), sizeof(subchunk1Size));
-      uint16_t audioFormat = 1;
-      out.write(reinterpret_cast<const char *>(&audioFormat), sizeof(audioFormat));
-      out.write(reinterpret_cast<const char *>(&num_channels), sizeof(num_channels));
-      out.write(reinterpret_cast<const char *>(&sample_rate), sizeof(sample_rate));
-      uint16_t bytesPerSample = bits_per_sample / 8;
-      uint16_t localBlockAlign = num_channels * bytesPerSample;
-      uint32_t byteRate = sample_rate * localBlockAlign;
-      out.write(reinterpret_cast<const char *>(&byteRate), sizeof(byteRate));
-      out.write(reinterpret_cast<const char *>(&localBlockAlign), sizeof(localBlockAlign));
-      out.write(reinterpret_cast<const char *>(&bits_per_sample), sizeof(bits_per_sample));
-      out.write("data", 4);
-      out.write(reinterpret_cast<const char *>(&data_size), sizeof(data_size));
-      out.write(reinterpret_cast<const char *>(raw_data.data()), data_size);
-      out.close();
+      std::memcpy(&chunk_size, data + 4, sizeof(chunk_size));
+      if (std::strncmp(data + 8, "WAVE", 4) != 0)
+      {
+        std::cerr << "Format must be 'WAVE'" << std::endl;
+        return false;
+      }
+      bool foundFmt = false, foundData = false;
+      uint64_t pos = 12;
+      while (pos + 8 <= size && (!foundFmt || !foundData))
+      {
+        const char *subchunkID = data + pos;
+        uint32_t subchunk_size = 0;
+        std::memcpy(&subchunk_size, data + pos + 4, sizeof(subchunk_size));
+        pos += 8;
+        if (std::strncmp(subchunkID, "fmt ", 4) == 0)
+        {
+          if (pos + 16 > size)
+            break;
+          foundFmt = true;
+          std::memcpy(&num_channels, data + pos + 2, sizeof(num_channels));
+          std::memcpy(&sample_rate, data + pos + 4, sizeof(sample_rate));
+          std::memcpy(&block_align, data + pos + 12, sizeof(block_align));
+          std::memcpy(&bits_per_sample, data + pos + 14, sizeof(bits_per_sample));
+          pos += std::max<uint32_t>(subchunk_size, 16);
+        }
+        else if (std::strncmp(subchunkID, "data", 4) == 0)
+        {
+          foundData = true;
+          data_size = subchunk_size;
+          data_offset = pos;
+          pos += subchunk_size;
+        }
+        else
+        {
+          pos += subchunk_size;
+        }
+      }
+      if (!foundFmt)
+      {
+        std::cerr << "Couldn't find 'fmt ' subchunk." << std::endl;
+        return false;
+      }
+      if (!foundData)
+      {
+        std::cerr << "Couldn't find 'data' subchunk." << std::endl;
+        return false;
+      }
+      if (block_align == 0)
+      {
+        std::cerr << "BlockAlign must not be 0." << std::endl;
+        return false;
+      }
+      num_samples = data_size / block_align;
       return true;
     }
   };
 
+  // Reads only the header of a WAV file: format, sample count and data offset.
+  inline bool probe(const std::string &filePath, WavInfo &info, bool quiet = false)
+  {
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file.is_open())
+    {
+      if (!quiet)
+        std::cerr << "Couldn't open file: " << filePath << std::endl;
+      return false;
+    }
+    return info.read(file, quiet);
+  }
+
   //------------------------------------------------------------------------------
-  // WavData<T>: Stores deinterleaved, typed audio data.
+  // Access hints: How a reader or writer will use a file's pages.
   //------------------------------------------------------------------------------
-  template <typename T>
-  struct WavData
+  // Passed to the kernel with posix_fadvise()/madvise(). They only change what
+  // stays in the page cache, never results, and are ignored where unsupported.
+  enum class AccessPattern
   {
-    uint32_t sample_rate = 0;
-    uint16_t num_channels = 0;
-    uint16_t bits_per_sample = 0;
-    uint32_t num_samples = 0; // per channel
-    std::vector<T> channel1;  // Left channel (or mono)
-    std::vector<T> channel2;  // Right channel (if stereo)
+    Normal,     // kernel default read-ahead
+    Sequential, // one pass front to back: larger read-ahead
+    Random      // scattered reads: no read-ahead
+  };
 
-    WavData() = default;
+  struct IoHints
+  {
+    AccessPattern pattern = AccessPattern::Normal;
+    uint64_t read_ahead = 0;  // window read (and prefetched) at a time; 0 = 8 MiB
+    bool drop_behind = false; // evict each window once consumed or written, so
+                              // a large pass doesn't push other data out of the cache
+    bool direct = false;      // bypass the page cache entirely (O_DIRECT), for
+                              // WavFile::read and WavFile::save
+  };
 
-    // Constructs WavData from a WavFile by extracting each sample using block alignment.
-    WavData(const WavFile &wf)
+  //------------------------------------------------------------------------------
+  // I/O and threading helpers.
+  //------------------------------------------------------------------------------
+  namespace detail
+  {
+    constexpr uint64_t kDefaultReadAhead = 8 << 20;
+
+    inline uint64_t readAheadWindow(const IoHints &hints)
     {
-      sample_rate = wf.sample_rate;
-      num_channels = wf.num_channels;
-      bits_per_sample = wf.bits_per_sample;
-      num_samples = wf.num_samples;
-      // Check that T matches file bit depth.
-      if (bits_per_sample != sizeof(T) * 8)
+      return hints.read_ahead ? hints.read_ahead : kDefaultReadAhead;
+    }
+
+#ifdef WAVLIB_POSIX
+    // posix_fadvise() is missing on macOS; there the hints are dropped.
+    inline void adviseFile(int fd, uint64_t offset, uint64_t length, int advice)
+    {
+#ifdef POSIX_FADV_NORMAL
+      ::posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(length), advice);
+#else
+      (void)fd, (void)offset, (void)length, (void)advice;
+#endif
+    }
+
+    inline void adviseFile(int fd, AccessPattern pattern)
+    {
+#ifdef POSIX_FADV_NORMAL
+      int advice = pattern == AccessPattern::Sequential ? POSIX_FADV_SEQUENTIAL
+                   : pattern == AccessPattern::Random   ? POSIX_FADV_RANDOM
+                                                        : POSIX_FADV_NORMAL;
+      adviseFile(fd, 0, 0, advice);
+#else
+      (void)fd, (void)pattern;
+#endif
+    }
+
+    inline void prefetchFile(int fd, uint64_t offset, uint64_t length)
+    {
+#ifdef POSIX_FADV_WILLNEED
+      adviseFile(fd, offset, length, POSIX_FADV_WILLNEED);
+#else
+      (void)fd, (void)offset, (void)length;
+#endif
+    }
+
+    // Drops a range from the page cache. Dirty pages can't be dropped, so on
+    // Linux the range is written back first.
+    inline void releaseFile(int fd, uint64_t offset, uint64_t length, bool written = false)
+    {
+#if defined(__linux__)
+      if (written)
+        ::sync_file_range(fd, static_cast<off_t>(offset), static_cast<off_t>(length),
+                          SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+#else
+      (void)written;
+#endif
+#ifdef POSIX_FADV_DONTNEED
+      adviseFile(fd, offset, length, POSIX_FADV_DONTNEED);
+#else
+      (void)fd, (void)offset, (void)length;
+#endif
+    }
+
+    // Starts writing a dirty range back without waiting for it (Linux only).
+    inline void writebackFile(int fd, uint64_t offset, uint64_t length)
+    {
+#if defined(__linux__)
+      ::sync_file_range(fd, static_cast<off_t>(offset), static_cast<off_t>(length), SYNC_FILE_RANGE_WRITE);
+#else
+      (void)fd, (void)offset, (void)length;
+#endif
+    }
+#endif
+
+    // A read-only file supporting concurrent positional reads: pread() on POSIX,
+    // a mutex-guarded std::ifstream elsewhere.
+    class RandomAccessFile
+    {
+    public:
+      RandomAccessFile() = default;
+      RandomAccessFile(const RandomAccessFile &) = delete;
+      RandomAccessFile &operator=(const RandomAccessFile &) = delete;
+      ~RandomAccessFile() { close(); }
+
+      bool open(const std::string &filePath, AccessPattern pattern = AccessPattern::Normal)
       {
-        std::cerr << "Bit depth mismatch: file has " << bits_per_sample
-                  << " bits, but T is " << (sizeof(T) * 8) << " bits." << std::endl;
-        return;
+        close();
+#ifdef WAVLIB_POSIX
+        fd_ = ::open(filePath.c_str(), O_RDONLY);
+        if (fd_ < 0)
+#else
+        file_.open(filePath, std::ios::binary);
+        if (!file_.is_open())
+#endif
+        {
+          std::cerr << "Couldn't open file: " << filePath << std::endl;
+          return false;
+        }
+#ifdef WAVLIB_POSIX
+        if (pattern != AccessPattern::Normal)
+          adviseFile(fd_, pattern);
+#else
+        (void)pattern;
+#endif
+        return true;
       }
-      // Use block alignment: each sample block is wf.block_align bytes.
-      channel1.resize(num_samples);
-      if (num_channels == 2)
-        channel2.resize(num_samples);
-      uint32_t blockAlign = wf.block_align;
-      for (uint32_t i = 0; i < num_samples; i++)
+
+      void close()
       {
-        // Compute the starting offset for sample i.
-        const char *samplePtr = wf.raw_data.data() + i * blockAlign;
-        // For each channel, extract sizeof(T) bytes.
-        // Left channel (channel 0).
-        std::memcpy(&channel1[i], samplePtr, sizeof(T));
-        // Right channel (if stereo).
-        if (num_channels == 2)
+#ifdef WAVLIB_POSIX
+        if (fd_ >= 0)
+          ::close(fd_);
+        fd_ = -1;
+#else
+        file_.close();
+#endif
+      }
+
+      // Reads exactly size bytes at offset; false on error or short file.
+      bool readAt(uint64_t offset, char *buffer, size_t size)
+      {
+#ifdef WAVLIB_POSIX
+        while (size > 0)
         {
-          std::memcpy(&channel2[i], samplePtr + sizeof(T), sizeof(T));
+          ssize_t n = ::pread(fd_, buffer, size, static_cast<off_t>(offset));
+          if (n < 0 && errno == EINTR)
+            continue;
+          if (n <= 0)
+            return false;
+          buffer += n;
+          offset += static_cast<uint64_t>(n);
+          size -= static_cast<size_t>(n);
         }
+        return true;
+#else
+        std::lock_guard<std::mutex> lock(mutex_);
+        file_.clear();
+        file_.seekg(static_cast<std::streamoff>(offset));
+        file_.read(buffer, static_cast<std::streamsize>(size));
+        return static_cast<size_t>(file_.gcount()) == size;
+#endif
       }
-    }
 
-    // Converts this WavData into a complete WavFile.
-    WavFile toWavFile() const
-    {
-      WavFile wf;
-      wf.sample_rate = sample_rate;
-      wf.num_channels = num_channels;
-      wf.bits_per_sample = bits_per_sample;
-      wf.block_align = num_channels * (bits_per_sample / 8);
-      wf.num_samples = num_samples;
-      wf.data_size = num_samples * wf.block_align;
-      wf.raw_data.resize(wf.data_size);
-      // Interleave data: for each sample, write channel1 and (if stereo) channel2.
-      for (uint32_t i = 0; i < num_samples; i++)
+      // Asks the kernel to start reading a range in the background.
+      void prefetch(uint64_t offset, uint64_t length)
       {
-        // Compute destination pointer.
-        char *dest = wf.raw_data.data() + i * wf.block_align;
-        // Copy left channel.
-        std::memcpy(dest, &channel1[i], sizeof(T));
-        // Copy right channel if needed.
-        if (num_channels == 2)
+#ifdef WAVLIB_POSIX
+        prefetchFile(fd_, offset, length);
+#else
+        (void)offset, (void)length;
+#endif
+      }
+
+      // Drops a range that won't be read again from the page cache.
+      void release(uint64_t offset, uint64_t length)
+      {
+#ifdef WAVLIB_POSIX
+        releaseFile(fd_, offset, length);
+#else
+        (void)offset, (void)length;
+#endif
+      }
+
+      // readAt() in windows of hints.read_ahead bytes, prefetching the next
+      // window before copying the current one and releasing it afterwards
+      // when hints.drop_behind is set.
+      bool readSequential(uint64_t offset, char *buffer, size_t size, const IoHints &hints)
+      {
+        const size_t window = static_cast<size_t>(readAheadWindow(hints));
+        for (size_t done = 0; done < size;)
         {
-          std::memcpy(dest + sizeof(T), &channel2[i], sizeof(T));
+          size_t length = std::min(window, size - done);
+          if (done + length < size)
+            prefetch(offset + done + length, std::min(window, size - done - length));
+          if (!readAt(offset + done, buffer + done, length))
+            return false;
+          if (hints.drop_behind)
+            release(offset + done, length);
+          done += length;
         }
+        return true;
       }
-      wf.chunk_size = 36 + wf.data_size;
-      return wf;
-    }
 
-    // Saves this WavData to disk by converting to a WavFile and calling its save.
-    bool save(const std::string &filePath) const
+    private:
+#ifdef WAVLIB_POSIX
+      int fd_ = -1;
+#else
+      std::ifstream file_;
+      std::mutex mutex_;
+#endif
+    };
+
+    // A read-only memory mapping of a whole file (read into memory where mmap
+    // isn't available). Move-only.
+    class MappedFile
     {
-      WavFile wf = toWavFile();
-      return wf.save(filePath);
-    }
-  };
+    public:
+      MappedFile() = default;
+      MappedFile(const MappedFile &) = delete;
+      MappedFile &operator=(const MappedFile &) = delete;
+      MappedFile(MappedFile &&other) noexcept { *this = std::move(other); }
+      MappedFile &operator=(MappedFile &&other) noexcept
+      {
+        if (this != &other)
+        {
+          close();
+          data_ = other.data_;
+          size_ = other.size_;
+          fd_ = other.fd_;
+          buffer_ = std::move(other.buffer_);
+          other.data_ = nullptr;
+          other.size_ = 0;
+          other.fd_ = -1;
+        }
+        return *this;
+      }
+      ~MappedFile() { close(); }
 
-  //------------------------------------------------------------------------------
-  // Resample: Resamples a WavData<T> to a new sample rate using linear interpolation.
-  //------------------------------------------------------------------------------
-  template <typename T>
-  WavData<T> resample(const WavData<T> &input, uint32_t new_sample_rate)
-  {
-    WavData<T> output = input;
-    output.sample_rate = new_sample_rate;
-    double ratio = static_cast<double>(new_sample_rate) / input.sample_rate;
-    uint32_t newNumSamples = static_cast<uint32_t>(input.num_samples * ratio);
-    output.num_samples = newNumSamples;
-    output.channel1.resize(newNumSamples);
-    if (input.num_channels == 2)
-      output.channel2.resize(newNumSamples);
-    for (uint32_t i = 0; i < newNumSamples; i++)
-    {
-      double src_index = i / ratio;
-      uint32_t index0 = static_cast<uint32_t>(std::floor(src_index));
-      uint32_t index1 = (index0 + 1 < input.num_samples) ? index0 + 1 : index0;
-      double frac = src_index - index0;
-      double s0 = static_cast<double>(input.channel1[index0]);
-      double s1 = static_cast<double>(input.channel1[index1]);
-      double interp = (1.0 - frac) * s0 + frac * s1;
-      output.channel1[i] = static_cast<T>(std::round(interp));
-      if (input.num_channels == 2)
+      bool open(const std::string &filePath, AccessPattern pattern = AccessPattern::Normal)
       {
-        double t0 = static_cast<double>(input.channel2[index0]);
-        double t1 = static_cast<double>(input.channel2[index1]);
-        double interp2 = (1.0 - frac) * t0 + frac * t1;
-        output.channel2[i] = static_cast<T>(std::round(interp2));
+        close();
+#ifdef WAVLIB_POSIX
+        int fd = ::open(filePath.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd < 0 || ::fstat(fd, &st) != 0)
+        {
+          if (fd >= 0)
+            ::close(fd);
+          std::cerr << "Couldn't open file: " << filePath << std::endl;
+          return false;
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ > 0)
+        {
+          void *p = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+          if (p == MAP_FAILED)
+          {
+            ::close(fd);
+            size_ = 0;
+            std::cerr << "Couldn't map file: " << filePath << std::endl;
+            return false;
+          }
+          data_ = static_cast<const char *>(p);
+          if (pattern != AccessPattern::Normal)
+            ::madvise(p, size_, pattern == AccessPattern::Sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+        }
+        fd_ = fd; // kept for release()
+        return true;
+#else
+        (void)pattern;
+        std::ifstream file(filePath, std::ios::binary | std::ios::ate);
+        if (!file.is_open())
+        {
+          std::cerr << "Couldn't open file: " << filePath << std::endl;
+          return false;
+        }
+        buffer_.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+        data_ = buffer_.data();
+        size_ = buffer_.size();
+        return true;
+#endif
       }
-    }
-    return output;
-  }
 
-  //------------------------------------------------------------------------------
-  // convertSample: Converts a sample from type From to type To (distinguishing signed/unsigned).
-  //------------------------------------------------------------------------------
-  template <typename From, typename To>
-  To convertSample(From sample)
-  {
-    double fSample = static_cast<double>(sample);
-    double fromMin, fromMax, toMin, toMax;
-    if constexpr (std::is_signed<From>::value)
+      void close()
+      {
+#ifdef WAVLIB_POSIX
+        if (data_)
+          ::munmap(const_cast<char *>(data_), size_);
+        if (fd_ >= 0)
+          ::close(fd_);
+#endif
+        data_ = nullptr;
+        size_ = 0;
+        fd_ = -1;
+        buffer_.clear();
+      }
+
+      const char *data() const { return data_; }
+      size_t size() const { return size_; }
+
+      // Faults a range of the mapping in ahead of use.
+      void prefetch(size_t offset, size_t length) const
+      {
+#ifdef WAVLIB_POSIX
+        advise(offset, length, MADV_WILLNEED);
+#else
+        (void)offset, (void)length;
+#endif
+      }
+
+      // Unmaps the pages of a consumed range and drops them from the page cache.
+      void release(size_t offset, size_t length) const
+      {
+#ifdef WAVLIB_POSIX
+        advise(offset, length, MADV_DONTNEED);
+        if (fd_ >= 0)
+          releaseFile(fd_, offset, length);
+#else
+        (void)offset, (void)length;
+#endif
+      }
+
+    private:
+#ifdef WAVLIB_POSIX
+      // madvise() takes page-aligned addresses.
+      void advise(size_t offset, size_t length, int advice) const
+      {
+        if (!data_ || offset >= size_)
+          return;
+        length = std::min(length, size_ - offset);
+        size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        size_t begin = offset / page * page;
+        ::madvise(const_cast<char *>(data_) + begin, offset + length - begin, advice);
+      }
+#endif
+
+      const char *data_ = nullptr;
+      size_t size_ = 0;
+      int fd_ = -1;
+      std::vector<char> buffer_; // fallback storage without mmap
+    };
+
+    // Creates filePath and writes the buffers back to back, with a single
+    // writev() where available.
+    inline bool writeBuffers(const std::string &filePath, const std::vector<std::pair<const char *, size_t>> &buffers)
     {
-      fromMin = static_cast<double>(std::numeric_limits<From>::min());
-      fromMax = static_cast<double>(std::numeric_limits<From>::max());
+#ifdef WAVLIB_POSIX
+      int fd = ::open(filePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      if (fd < 0)
+      {
+        std::cerr << "Error opening output file: " << filePath << std::endl;
+        return false;
+      }
+      std::vector<struct iovec> iov;
+      for (const auto &b : buffers)
+        if (b.second > 0)
+          iov.push_back({const_cast<char *>(b.first), b.second});
+      size_t first = 0;
+      bool ok = true;
+      while (ok && first < iov.size())
+      {
+        int count = static_cast<int>(std::min<size_t>(iov.size() - first, IOV_MAX));
+        ssize_t n = ::writev(fd, iov.data() + first, count);
+        if (n < 0)
+        {
+          ok = false;
+          break;
+        }
+        // Skip fully written buffers and trim a partially written one.
+        size_t written = static_cast<size_t>(n);
+        while (first < iov.size() && written >= iov[first].iov_len)
+          written -= iov[first++].iov_len;
+        if (first < iov.size())
+        {
+          iov[first].iov_base = static_cast<char *>(iov[first].iov_base) + written;
+          iov[first].iov_len -= written;
+        }
+      }
+      ok = ::close(fd) == 0 && ok;
+      if (!ok)
+        std::cerr << "Error writing output file: " << filePath << std::endl;
+      return ok;
+#else
+      std::ofstream out(filePath, std::ios::binary);
+      if (!out.is_open())
+      {
+        std::cerr << "Error opening output file: " << filePath << std::endl;
+        return false;
+      }
+      for (const auto &b : buffers)
+        out.write(b.first, static_cast<std::streamsize>(b.second));
+      return static_cast<bool>(out);
+#endif
     }
-    else
+
+#ifdef WAVLIB_POSIX
+    // Direct I/O moves whole blocks between the device and user memory, so
+    // buffers, offsets and lengths must be multiples of the logical block size;
+    // 4096 covers every common device.
+    constexpr size_t kDirectAlign = 4096;
+
+    inline uint64_t alignUp(uint64_t value, uint64_t alignment)
     {
-      fromMin = 0.0;
-      fromMax = static_cast<double>(std::numeric_limits<From>::max());
+      return (value + alignment - 1) / alignment * alignment;
     }
-    if constexpr (std::is_signed<To>::value)
+
+    struct AlignedFree
     {
-      toMin = static_cast<double>(std::numeric_limits<To>::min());
-      toMax = static_cast<double>(std::numeric_limits<To>::max());
+      void operator()(char *p) const { std::free(p); }
+    };
+
+    inline std::unique_ptr<char, AlignedFree> allocateAligned(size_t size)
+    {
+      void *p = nullptr;
+      if (::posix_memalign(&p, kDirectAlign, size) != 0)
+        return nullptr;
+      return std::unique_ptr<char, AlignedFree>(static_cast<char *>(p));
     }
-    else
+
+    // Opens a file bypassing the page cache: O_DIRECT, or F_NOCACHE on macOS.
+    // File systems without direct I/O (tmpfs, some network mounts) get a
+    // regular descriptor; the aligned transfers below work on either.
+    inline int openDirect(const std::string &filePath, int flags, mode_t mode = 0)
     {
-      toMin = 0.0;
-      toMax = static_cast<double>(std::numeric_limits<To>::max());
+#ifdef O_DIRECT
+      int fd = ::open(filePath.c_str(), flags | O_DIRECT, mode);
+      if (fd < 0 && errno == EINVAL)
+        fd = ::open(filePath.c_str(), flags, mode);
+#else
+      int fd = ::open(filePath.c_str(), flags, mode);
+#ifdef F_NOCACHE
+      if (fd >= 0)
+        ::fcntl(fd, F_NOCACHE, 1);
+#endif
+#endif
+      return fd;
     }
-    double normalized = (fSample - fromMin) / (fromMax - fromMin);
-    double result = normalized * (toMax - toMin) + toMin;
-    return static_cast<To>(std::round(result));
-  }
 
-  //------------------------------------------------------------------------------
-  // Reencode: Converts a WavData from one sample type to another.
-  //------------------------------------------------------------------------------
-  template <typename From, typename To>
-  WavData<To> reencode(const WavData<From> &input)
-  {
-    WavData<To> output;
-    output.sample_rate = input.sample_rate;
+    // Reads size bytes at offset of filePath with direct I/O. Each transfer
+    // of up to `window` bytes lands in an aligned bounce buffer, starting
+    // and ending on block boundaries; the unaligned head (e.g. the 44-byte
+    // header before the samples) and the tail past the data are trimmed when
+    // copying out.
+    inline bool readDirect(const std::string &filePath, uint64_t offset, char *dest, size_t size, uint64_t window)
+    {
+      int fd = openDirect(filePath, O_RDONLY);
+      if (fd < 0)
+      {
+        std::cerr << "Couldn't open file: " << filePath << std::endl;
+        return false;
+      }
+      window = alignUp(std::max<uint64_t>(window, kDirectAlign), kDirectAlign);
+      auto buffer = allocateAligned(static_cast<size_t>(window));
+      const uint64_t end = offset + size;
+      const uint64_t alignedEnd = alignUp(end, kDirectAlign);
+      bool ok = buffer != nullptr;
+      for (uint64_t pos = offset / kDirectAlign * kDirectAlign; ok && pos < end; pos += window)
+      {
+        size_t want = static_cast<size_t>(std::min(window, alignedEnd - pos));
+        size_t got = 0;
+        while (got < want)
+        {
+          ssize_t n = ::pread(fd, buffer.get() + got, want - got, static_cast<off_t>(pos + got));
+          if (n <= 0)
+            break;
+          got += static_cast<size_t>(n);
+        }
+        uint64_t from = std::max(pos, offset);
+        uint64_t to = std::min(pos + got, end);
+        if (to > from)
+          std::memcpy(dest + (from - offset), buffer.get() + (from - pos), static_cast<size_t>(to - from));
+        ok = pos + got >= std::min(pos + want, end); // short only past the data
+      }
+      ::close(fd);
+      if (!ok)
+        std::cerr << "Couldn't read samples from: " << filePath << std::endl;
+      return ok;
+    }
+
+    // Creates filePath and writes the buffers back to back with direct I/O.
+    // They are packed into an aligned bounce buffer and written in whole
+    // blocks; the final block is zero-padded and the file then truncated to
+    // its real length.
+    inline bool writeBuffersDirect(const std::string &filePath,
+                                   const std::vector<std::pair<const char *, size_t>> &buffers, uint64_t window)
+    {
+      int fd = openDirect(filePath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      if (fd < 0)
+      {
+        std::cerr << "Error opening output file: " << filePath << std::endl;
+        return false;
+      }
+      window = alignUp(std::max<uint64_t>(window, kDirectAlign), kDirectAlign);
+      auto buffer = allocateAligned(static_cast<size_t>(window));
+      bool ok = buffer != nullptr;
+      uint64_t written = 0;
+      size_t filled = 0;
+      auto flush = [&](size_t length)
+      {
+        for (size_t done = 0; ok && done < length;)
+        {
+          ssize_t n = ::pwrite(fd, buffer.get() + done, length - done, static_cast<off_t>(written + done));
+          ok = n > 0;
+          done += ok ? static_cast<size_t>(n) : 0;
+        }
+        written += length;
+        filled = 0;
+      };
+      for (const auto &b : buffers)
+      {
+        for (size_t used = 0; ok && used < b.second;)
+        {
+          size_t length = std::min(b.second - used, static_cast<size_t>(window) - filled);
+          std::memcpy(buffer.get() + filled, b.first + used, length);
+          filled += length;
+          used += length;
+          if (filled == window)
+            flush(filled);
+        }
+      }
+      uint64_t total = written + filled;
+      if (ok && filled > 0)
+      {
+        size_t padded = static_cast<size_t>(alignUp(filled, kDirectAlign));
+        std::memset(buffer.get() + filled, 0, padded - filled);
+        flush(padded);
+      }
+      ok = ok && ::ftruncate(fd, static_cast<off_t>(total)) == 0;
+      ok = ::close(fd) == 0 && ok;
+      if (!ok)
+        std::cerr << "Error writing output file: " << filePath << std::endl;
+      return ok;
+    }
+#endif
+
+    // What identifies a file's contents without reading it.
+    struct FileIdentity
+    {
+      uint64_t size = 0;
+      int64_t mtime_ns = 0;
+      uint64_t inode = 0; // 0 where unavailable
+    };
+
+    inline bool fileIdentity(const std::string &filePath, FileIdentity &id)
+    {
+#ifdef WAVLIB_POSIX
+      struct stat st;
+      if (::stat(filePath.c_str(), &st) != 0)
+        return false;
+      id.size = static_cast<uint64_t>(st.st_size);
+#if defined(__APPLE__)
+      id.mtime_ns = static_cast<int64_t>(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+      id.mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+      id.inode = static_cast<uint64_t>(st.st_ino);
+      return true;
+#else
+      std::error_code ec;
+      id.size = std::filesystem::file_size(filePath, ec);
+      if (ec)
+        return false;
+      id.mtime_ns = static_cast<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                             std::filesystem::last_write_time(filePath, ec).time_since_epoch())
+                                             .count());
+      id.inode = 0;
+      return !ec;
+#endif
+    }
+
+    // 64-bit FNV-1a.
+    inline uint64_t hashBytes(const std::string &bytes)
+    {
+      uint64_t hash = 0xcbf29ce484222325ull;
+      for (unsigned char c : bytes)
+      {
+        hash ^= c;
+        hash *= 0x100000001b3ull;
+      }
+      return hash;
+    }
+
+    // Runs fn(i) for every i in [0, count) on up to `threads` worker threads
+    // (0 = hardware concurrency). Indices are handed out dynamically.
+    template <typename F>
+    void parallelFor(size_t count, unsigned threads, F &&fn)
+    {
+      if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+      threads = static_cast<unsigned>(std::min<size_t>(threads, count));
+      if (threads <= 1)
+      {
+        for (size_t i = 0; i < count; i++)
+          fn(i);
+        return;
+      }
+      std::atomic<size_t> next(0);
+      auto worker = [&]()
+      {
+        for (size_t i = next++; i < count; i = next++)
+          fn(i);
+      };
+      std::vector<std::thread> pool;
+      for (unsigned t = 1; t < threads; t++)
+        pool.emplace_back(worker);
+      worker();
+      for (std::thread &t : pool)
+        t.join();
+    }
+  } // namespace detail
+
+  //------------------------------------------------------------------------------
+  // WavFile: Represents a complete WAV file (header and interleaved raw audio data).
+  //------------------------------------------------------------------------------
+  struct WavFile
+  {
+    uint32_t chunk_size = 0;
+    uint16_t num_channels = 0;
+    uint32_t sample_rate = 0;
+    uint16_t block_align = 0;
+    uint16_t bits_per_sample = 0;
+    uint32_t data_size = 0;
+    uint32_t num_samples = 0; // per channel
+    std::vector<char> raw_data;
+
+    // Files up to this size are read with a single read() and parsed in memory.
+    static constexpr uint64_t kSmallFileBytes = 512 << 10;
+
+    // Reads a WAV file from disk.
+    bool read(const std::string &filePath)
+    {
+#ifdef WAVLIB_POSIX
+      int fd = ::open(filePath.c_str(), O_RDONLY);
+      struct stat st;
+      if (fd >= 0 && ::fstat(fd, &st) == 0 && S_ISREG(st.st_mode) &&
+          static_cast<uint64_t>(st.st_size) <= kSmallFileBytes)
+      {
+        bool ok = readSmall(fd, static_cast<size_t>(st.st_size));
+        ::close(fd);
+        return ok;
+      }
+      if (fd >= 0)
+        ::close(fd);
+#endif
+      std::ifstream file(filePath, std::ios::binary);
+      if (!file.is_open())
+      {
+        std::cerr << "Couldn't open file: " << filePath << std::endl;
+        return false;
+      }
+      WavInfo info;
+      if (!info.read(file))
+        return false;
+      setInfo(info);
+      raw_data.resize(data_size);
+      file.read(raw_data.data(), data_size);
+      return true;
+    }
+
+    // Reads a WAV file with page-cache hints, e.g. {Sequential, 0, true} for
+    // a one-pass batch job that shouldn't evict other processes' data.
+    bool read(const std::string &filePath, const IoHints &hints)
+    {
+      WavInfo info;
+      if (!probe(filePath, info))
+        return false;
+#ifdef WAVLIB_POSIX
+      if (hints.direct)
+      {
+        setInfo(info);
+        raw_data.resize(data_size);
+        return detail::readDirect(filePath, info.data_offset, raw_data.data(), data_size,
+                                  detail::readAheadWindow(hints));
+      }
+#endif
+      detail::RandomAccessFile file;
+      if (!file.open(filePath, hints.pattern))
+        return false;
+      setInfo(info);
+      raw_data.resize(data_size);
+      if (!file.readSequential(info.data_offset, raw_data.data(), data_size, hints))
+      {
+        std::cerr << "Couldn't read samples from: " << filePath << std::endl;
+        return false;
+      }
+      return true;
+    }
+
+#ifdef WAVLIB_POSIX
+    // Reads the whole file into raw_data and adopts it. A WavFile reused
+    // across reads keeps its buffer's capacity. On failure raw_data is empty.
+    bool readSmall(int fd, size_t size)
+    {
+      raw_data.resize(size);
+      for (size_t done = 0; done < size;)
+      {
+        ssize_t n = ::read(fd, raw_data.data() + done, size - done);
+        if (n < 0 && errno == EINTR)
+          continue;
+        if (n < 0)
+        {
+          raw_data.clear();
+          return false;
+        }
+        if (n == 0)
+        {
+          size = done; // file shrank while reading
+          break;
+        }
+        done += static_cast<size_t>(n);
+      }
+      return adoptBuffer(size);
+    }
+#endif
+
+    // Takes a whole file already read into raw_data[0, size): parses its
+    // chunks and moves the samples to the front, so the buffer becomes the
+    // sample storage rather than being copied.
+    bool adoptBuffer(size_t size)
+    {
+      WavInfo info;
+      if (!info.parse(raw_data.data(), size))
+      {
+        raw_data.clear(); // don't leave the unparsed file posing as samples
+        return false;
+      }
+      setInfo(info);
+      size_t available = static_cast<size_t>(std::min<uint64_t>(data_size, size - std::min<uint64_t>(info.data_offset, size)));
+      std::memmove(raw_data.data(), raw_data.data() + info.data_offset, available);
+      // Like the stream path, a data size past the end of the file leaves zeros.
+      std::fill(raw_data.begin() + available, raw_data.begin() + std::min<size_t>(raw_data.size(), data_size), 0);
+      raw_data.resize(data_size);
+      return true;
+    }
+
+    // Copies header fields from a WavInfo.
+    void setInfo(const WavInfo &info)
+    {
+      chunk_size = info.chunk_size;
+      num_channels = info.num_channels;
+      sample_rate = info.sample_rate;
+      block_align = info.block_align;
+      bits_per_sample = info.bits_per_sample;
+      data_size = info.data_size;
+      num_samples = info.num_samples;
+    }
+
+    // Saves this WAV file to disk.
+    bool save(const std::string &filePath) const
+    {
+      std::ofstream out(filePath, std::ios::binary);
+      if (!out.is_open())
+      {
+        std::cerr << "Error opening output file: " << filePath << std::endl;
+        return false;
+      }
+      std::array<char, 44> h = header();
+      out.write(h.data(), h.size());
+      out.write(reinterpret_cast<const char *>(raw_data.data()), data_size);
+      out.close();
+      return true;
+    }
+
+    // Saves with hints.direct honoured: header and samples are written with
+    // O_DIRECT, leaving the page cache alone. Other hints apply to WavWriter.
+    bool save(const std::string &filePath, const IoHints &hints) const
+    {
+#ifdef WAVLIB_POSIX
+      if (hints.direct)
+      {
+        std::array<char, 44> h = header();
+        return detail::writeBuffersDirect(filePath, {{h.data(), h.size()}, {raw_data.data(), data_size}},
+                                          detail::readAheadWindow(hints));
+      }
+#else
+      (void)hints;
+#endif
+      return save(filePath);
+    }
+
+    // The canonical 44-byte header that save() writes.
+    std::array<char, 44> header() const
+    {
+      std::array<char, 44> h;
+      uint32_t subchunk1Size = 16;
+      uint16_t audioFormat = 1;
+      uint16_t bytesPerSample = bits_per_sample / 8;
+      uint16_t localBlockAlign = num_channels * bytesPerSample;
+      uint32_t byteRate = sample_rate * localBlockAlign;
+      std::memcpy(h.data(), "RIFF", 4);
+      std::memcpy(h.data() + 4, &chunk_size, 4);
+      std::memcpy(h.data() + 8, "WAVEfmt ", 8);
+      std::memcpy(h.data() + 16, &subchunk1Size, 4);
+      std::memcpy(h.data() + 20, &audioFormat, 2);
+      std::memcpy(h.data() + 22, &num_channels, 2);
+      std::memcpy(h.data() + 24, &sample_rate, 4);
+      std::memcpy(h.data() + 28, &byteRate, 4);
+      std::memcpy(h.data() + 32, &localBlockAlign, 2);
+      std::memcpy(h.data() + 34, &bits_per_sample, 2);
+      std::memcpy(h.data() + 36, "data", 4);
+      std::memcpy(h.data() + 40, &data_size, 4);
+      return h;
+    }
+  };
+
+  //------------------------------------------------------------------------------
+  // Kernels: Inner loops specialized on a compile-time channel count.
+  //------------------------------------------------------------------------------
+  namespace detail
+  {
+    // A channel count known at compile time; 0 means "use the runtime count".
+    template <uint16_t N>
+    using ChannelCount = std::integral_constant<uint16_t, N>;
+
+    // Calls f(ChannelCount<N>()) for the common layouts (1, 2, 6 and 8 channels),
+    // or f(ChannelCount<0>()) for anything else.
+    template <typename F>
+    void dispatchChannels(uint16_t numChannels, F &&f)
+    {
+      switch (numChannels)
+      {
+      case 1:
+        f(ChannelCount<1>());
+        break;
+      case 2:
+        f(ChannelCount<2>());
+        break;
+      case 6:
+        f(ChannelCount<6>());
+        break;
+      case 8:
+        f(ChannelCount<8>());
+        break;
+      default:
+        f(ChannelCount<0>());
+        break;
+      }
+    }
+
+    // Calls f(T()) with the sample type matching bits per sample. Returns false
+    // for bit depths WavData can't hold (24-bit PCM has no native type here).
+    template <typename F>
+    bool dispatchFormat(uint16_t bitsPerSample, F &&f)
+    {
+      switch (bitsPerSample)
+      {
+      case 8:
+        f(uint8_t());
+        return true;
+      case 16:
+        f(int16_t());
+        return true;
+      case 32:
+        f(int32_t());
+        return true;
+      default:
+        std::cerr << "Unsupported bit depth: " << bitsPerSample << " bits." << std::endl;
+        return false;
+      }
+    }
+
+    // Copies the left (or mono) and, for stereo, right samples out of interleaved
+    // frames. With Channels != 0 the frame size is a constant; otherwise the
+    // runtime blockAlign is used and right is filled when it isn't null.
+    template <typename T, uint16_t Channels>
+    void deinterleave(const char *src, uint32_t frames, size_t blockAlign, T *left, T *right)
+    {
+      const size_t step = Channels ? Channels * sizeof(T) : blockAlign;
+      for (uint32_t i = 0; i < frames; i++)
+      {
+        const char *frame = src + i * step;
+        std::memcpy(&left[i], frame, sizeof(T));
+        if constexpr (Channels == 2)
+          std::memcpy(&right[i], frame + sizeof(T), sizeof(T));
+        else if constexpr (Channels == 0)
+        {
+          if (right)
+            std::memcpy(&right[i], frame + sizeof(T), sizeof(T));
+        }
+      }
+      (void)right;
+    }
+
+    // Copies one channel out of interleaved frames; src points at that channel's
+    // sample in the first frame.
+    template <typename T, uint16_t Channels>
+    void extractChannel(const char *src, uint32_t frames, size_t blockAlign, T *dest)
+    {
+      const size_t step = Channels ? Channels * sizeof(T) : blockAlign;
+      for (uint32_t i = 0; i < frames; i++)
+        std::memcpy(&dest[i], src + i * step, sizeof(T));
+    }
+
+    // Writes strided planar samples into interleaved frames; the inverse of
+    // deinterleave. Channels other than the first two are left untouched.
+    template <typename T, uint16_t Channels>
+    void interleave(const T *left, const T *right, size_t stride, uint32_t frames,
+                    size_t blockAlign, char *dest)
+    {
+      const size_t step = Channels ? Channels * sizeof(T) : blockAlign;
+      for (uint32_t i = 0; i < frames; i++)
+      {
+        char *frame = dest + i * step;
+        std::memcpy(frame, &left[i * stride], sizeof(T));
+        if constexpr (Channels == 2)
+          std::memcpy(frame + sizeof(T), &right[i * stride], sizeof(T));
+      }
+      (void)right;
+    }
+  } // namespace detail
+
+  //------------------------------------------------------------------------------
+  // WavView<T>: Non-owning view of typed audio data (planar or interleaved).
+  //------------------------------------------------------------------------------
+  // Sample i of a channel lives at channelN[i * stride]; stride is 1 for planar
+  // buffers and num_channels for interleaved ones. The viewed buffers must
+  // outlive the view.
+  template <typename T>
+  struct WavView
+  {
+    uint32_t sample_rate = 0;
+    uint16_t num_channels = 0;
+    uint16_t bits_per_sample = 0;
+    uint32_t num_samples = 0;    // per channel
+    const T *channel1 = nullptr; // Left channel (or mono)
+    const T *channel2 = nullptr; // Right channel (if stereo)
+    uint32_t stride = 1;         // in samples, between consecutive frames
+
+    WavView() = default;
+
+    // Views the interleaved raw data of a WavFile without deinterleaving it.
+    WavView(const WavFile &wf)
+    {
+      sample_rate = wf.sample_rate;
+      num_channels = wf.num_channels;
+      bits_per_sample = wf.bits_per_sample;
+      if (bits_per_sample != sizeof(T) * 8)
+      {
+        std::cerr << "Bit depth mismatch: file has " << bits_per_sample
+                  << " bits, but T is " << (sizeof(T) * 8) << " bits." << std::endl;
+        return;
+      }
+      num_samples = wf.num_samples;
+      stride = wf.block_align / sizeof(T);
+      channel1 = reinterpret_cast<const T *>(wf.raw_data.data());
+      if (num_channels == 2)
+        channel2 = channel1 + 1;
+    }
+
+    // Returns sample i of the given channel (0 = left/mono, 1 = right).
+    T sample(uint16_t channel, uint32_t i) const
+    {
+      return (channel == 0 ? channel1 : channel2)[static_cast<size_t>(i) * stride];
+    }
+
+    // Returns a view of count frames starting at frame start, clamped to this view.
+    WavView slice(uint32_t start, uint32_t count) const
+    {
+      WavView out = *this;
+      if (start > num_samples)
+        start = num_samples;
+      if (count > num_samples - start)
+        count = num_samples - start;
+      out.num_samples = count;
+      if (channel1)
+        out.channel1 = channel1 + static_cast<size_t>(start) * stride;
+      if (channel2)
+        out.channel2 = channel2 + static_cast<size_t>(start) * stride;
+      return out;
+    }
+
+    // Interleaves the viewed frames into a complete WavFile.
+    WavFile toWavFile() const
+    {
+      WavFile wf;
+      wf.sample_rate = sample_rate;
+      wf.num_channels = num_channels;
+      wf.bits_per_sample = bits_per_sample;
+      wf.block_align = num_channels * (bits_per_sample / 8);
+      wf.num_samples = num_samples;
+      wf.data_size = num_samples * wf.block_align;
+      wf.raw_data.resize(wf.data_size);
+      if (num_channels == 1)
+        detail::interleave<T, 1>(channel1, channel2, stride, num_samples, wf.block_align, wf.raw_data.data());
+      else if (num_channels == 2)
+        detail::interleave<T, 2>(channel1, channel2, stride, num_samples, wf.block_align, wf.raw_data.data());
+      else
+        detail::interleave<T, 0>(channel1, channel2, stride, num_samples, wf.block_align, wf.raw_data.data());
+      wf.chunk_size = 36 + wf.data_size;
+      return wf;
+    }
+
+    // Saves the viewed frames to disk.
+    bool save(const std::string &filePath) const
+    {
+      return toWavFile().save(filePath);
+    }
+  };
+
+  //------------------------------------------------------------------------------
+  // WavData<T>: Stores deinterleaved, typed audio data.
+  //------------------------------------------------------------------------------
+  template <typename T>
+  struct WavData
+  {
+    uint32_t sample_rate = 0;
+    uint16_t num_channels = 0;
+    uint16_t bits_per_sample = 0;
+    uint32_t num_samples = 0; // per channel
+    std::vector<T> channel1;  // Left channel (or mono)
+    std::vector<T> channel2;  // Right channel (if stereo)
+
+    WavData() = default;
+
+    // Constructs WavData from a WavFile by extracting each sample using block alignment.
+    WavData(const WavFile &wf)
+    {
+      sample_rate = wf.sample_rate;
+      num_channels = wf.num_channels;
+      bits_per_sample = wf.bits_per_sample;
+      num_samples = wf.num_samples;
+      // Check that T matches file bit depth.
+      if (bits_per_sample != sizeof(T) * 8)
+      {
+        std::cerr << "Bit depth mismatch: file has " << bits_per_sample
+                  << " bits, but T is " << (sizeof(T) * 8) << " bits." << std::endl;
+        return;
+      }
+      // Use block alignment: each sample block is wf.block_align bytes.
+      channel1.resize(num_samples);
+      if (num_channels == 2)
+        channel2.resize(num_samples);
+      const char *src = wf.raw_data.data();
+      T *right = num_channels == 2 ? channel2.data() : nullptr;
+      if (wf.block_align != num_channels * sizeof(T))
+      {
+        detail::deinterleave<T, 0>(src, num_samples, wf.block_align, channel1.data(), right);
+        return;
+      }
+      detail::dispatchChannels(num_channels, [&](auto channels)
+                               { detail::deinterleave<T, decltype(channels)::value>(
+                                     src, num_samples, wf.block_align, channel1.data(), right); });
+    }
+
+    // Materializes a (possibly strided or sliced) view into owned channel buffers.
+    explicit WavData(const WavView<T> &v)
+    {
+      sample_rate = v.sample_rate;
+      num_channels = v.num_channels;
+      bits_per_sample = v.bits_per_sample;
+      num_samples = v.num_samples;
+      channel1.resize(num_samples);
+      if (num_channels == 2)
+        channel2.resize(num_samples);
+      for (uint32_t i = 0; i < num_samples; i++)
+      {
+        channel1[i] = v.channel1[static_cast<size_t>(i) * v.stride];
+        if (num_channels == 2)
+          channel2[i] = v.channel2[static_cast<size_t>(i) * v.stride];
+      }
+    }
+
+    // Returns a non-owning planar view of all samples.
+    WavView<T> view() const
+    {
+      WavView<T> v;
+      v.sample_rate = sample_rate;
+      v.num_channels = num_channels;
+      v.bits_per_sample = bits_per_sample;
+      v.num_samples = num_samples;
+      v.channel1 = channel1.data();
+      if (num_channels == 2)
+        v.channel2 = channel2.data();
+      return v;
+    }
+
+    // Returns a non-owning view of count samples starting at start (no copy).
+    WavView<T> slice(uint32_t start, uint32_t count) const
+    {
+      return view().slice(start, count);
+    }
+
+    // Converts this WavData into a complete WavFile.
+    WavFile toWavFile() const
+    {
+      return view().toWavFile();
+    }
+
+    // Saves this WavData to disk by converting to a WavFile and calling its save.
+    bool save(const std::string &filePath) const
+    {
+      WavFile wf = toWavFile();
+      return wf.save(filePath);
+    }
+  };
+
+  //------------------------------------------------------------------------------
+  // WavWriter: Streams interleaved frames to disk, patching the header on close.
+  //------------------------------------------------------------------------------
+  class WavWriter
+  {
+  public:
+    WavWriter() = default;
+    WavWriter(const WavWriter &) = delete;
+    WavWriter &operator=(const WavWriter &) = delete;
+    ~WavWriter() { close(); }
+
+    // Creates the file and writes a header with placeholder sizes. With
+    // hints.drop_behind, each hints.read_ahead bytes written are flushed and
+    // dropped from the page cache once the kernel has written them back.
+    bool open(const std::string &filePath, uint32_t sample_rate, uint16_t num_channels,
+              uint16_t bits_per_sample, const IoHints &hints = IoHints())
+    {
+      close();
+      out_.open(filePath, std::ios::binary | std::ios::trunc);
+      if (!out_.is_open())
+      {
+        std::cerr << "Error opening output file: " << filePath << std::endl;
+        return false;
+      }
+      flushed_ = released_ = 0;
+      window_ = detail::readAheadWindow(hints);
+#ifdef WAVLIB_POSIX
+      // std::ofstream doesn't expose its descriptor; advice applies to the
+      // file, so a second descriptor on it does the same job.
+      if (hints.drop_behind)
+        advice_fd_ = ::open(filePath.c_str(), O_WRONLY);
+#endif
+      WavFile header;
+      header.sample_rate = sample_rate;
+      header.num_channels = num_channels;
+      header.bits_per_sample = bits_per_sample;
+      block_align_ = num_channels * (bits_per_sample / 8);
+      num_samples_ = 0;
+      header.chunk_size = 36;
+      writeHeader(header);
+      return static_cast<bool>(out_);
+    }
+
+    bool is_open() const { return out_.is_open(); }
+    uint16_t block_align() const { return block_align_; }
+    uint32_t num_samples() const { return num_samples_; }
+
+    // Appends count interleaved frames of block_align() bytes each.
+    bool write(const char *frames, uint32_t count)
+    {
+      out_.write(frames, static_cast<std::streamsize>(count) * block_align_);
+      num_samples_ += count;
+#ifdef WAVLIB_POSIX
+      if (advice_fd_ >= 0)
+        dropWritten();
+#endif
+      return static_cast<bool>(out_);
+    }
+
+    // Appends the frames of a view, interleaving them in bounded chunks.
+    template <typename T>
+    bool write(const WavView<T> &frames)
+    {
+      const uint32_t kChunk = 4096;
+      for (uint32_t start = 0; start < frames.num_samples; start += kChunk)
+      {
+        WavFile chunk = frames.slice(start, kChunk).toWavFile();
+        if (!write(chunk.raw_data.data(), chunk.num_samples))
+          return false;
+      }
+      return true;
+    }
+
+    // Patches the RIFF and data sizes and closes the file.
+    bool close()
+    {
+      if (!out_.is_open())
+        return true;
+      uint32_t dataSize = num_samples_ * block_align_;
+      uint32_t chunkSize = 36 + dataSize;
+      out_.seekp(4);
+      out_.write(reinterpret_cast<const char *>(&chunkSize), sizeof(chunkSize));
+      out_.seekp(40);
+      out_.write(reinterpret_cast<const char *>(&dataSize), sizeof(dataSize));
+      bool ok = static_cast<bool>(out_);
+      out_.close();
+#ifdef WAVLIB_POSIX
+      if (advice_fd_ >= 0)
+      {
+        detail::releaseFile(advice_fd_, released_, 0, true);
+        ::close(advice_fd_);
+        advice_fd_ = -1;
+      }
+#endif
+      return ok;
+    }
+
+  private:
+#ifdef WAVLIB_POSIX
+    // Once a full window has been written: flush it and start its writeback,
+    // then drop the previous window, whose writeback has had a window's worth
+    // of time to finish.
+    void dropWritten()
+    {
+      uint64_t end = 44 + static_cast<uint64_t>(num_samples_) * block_align_;
+      if (end - flushed_ < window_)
+        return;
+      out_.flush();
+      detail::writebackFile(advice_fd_, flushed_, end - flushed_);
+      if (flushed_ > released_)
+        detail::releaseFile(advice_fd_, released_, flushed_ - released_, true);
+      released_ = flushed_;
+      flushed_ = end;
+    }
+
+    int advice_fd_ = -1;
+#endif
+
+    void writeHeader(const WavFile &header)
+    {
+      out_.write("RIFF", 4);
+      out_.write(reinterpret_cast<const char *>(&header.chunk_size), sizeof(header.chunk_size));
+      out_.write("WAVE", 4);
+      out_.write("fmt ", 4);
+      uint32_t subchunk1Size = 16;
+      out_.write(reinterpret_cast<const char *>(&subchunk1Size), sizeof(subchunk1Size));
+      uint16_t audioFormat = 1;
+      out_.write(reinterpret_cast<const char *>(&audioFormat), sizeof(audioFormat));
+      out_.write(reinterpret_cast<const char *>(&header.num_channels), sizeof(header.num_channels));
+      out_.write(reinterpret_cast<const char *>(&header.sample_rate), sizeof(header.sample_rate));
+      uint32_t byteRate = header.sample_rate * block_align_;
+      out_.write(reinterpret_cast<const char *>(&byteRate), sizeof(byteRate));
+      out_.write(reinterpret_cast<const char *>(&block_align_), sizeof(block_align_));
+      out_.write(reinterpret_cast<const char *>(&header.bits_per_sample), sizeof(header.bits_per_sample));
+      out_.write("data", 4);
+      uint32_t dataSize = 0;
+      out_.write(reinterpret_cast<const char *>(&dataSize), sizeof(dataSize));
+    }
+
+    std::ofstream out_;
+    uint16_t block_align_ = 0;
+    uint32_t num_samples_ = 0;
+    uint64_t window_ = 0;
+    uint64_t flushed_ = 0;  // bytes flushed and queued for writeback
+    uint64_t released_ = 0; // bytes dropped from the page cache
+  };
+
+  //------------------------------------------------------------------------------
+  // WavStreamReader / WavStreamWriter: Forward-only WAV I/O for pipes and stdin.
+  //------------------------------------------------------------------------------
+  // The reader never seeks: chunks before the samples are skipped by reading
+  // them, and a data size of 0 or 0xFFFFFFFF (left by writers that couldn't
+  // seek back to patch it) means "read until end of stream". Samples are
+  // handed out in blocks, so memory use doesn't grow with the stream.
+  class WavStreamReader
+  {
+  public:
+    static constexpr uint32_t kUnknownSize = 0xFFFFFFFF;
+
+    explicit WavStreamReader(std::istream &in) : in_(in) {}
+
+    // Parses the header up to the first sample. "fmt " must precede "data",
+    // since a stream can't be rewound to find it.
+    bool open()
+    {
+      char riff[12];
+      if (!readExact(riff, sizeof(riff)) || std::strncmp(riff, "RIFF", 4) != 0 ||
+          std::strncmp(riff + 8, "WAVE", 4) != 0)
+      {
+        std::cerr << "Stream is not RIFF/WAVE." << std::endl;
+        return false;
+      }
+      std::memcpy(&info_.chunk_size, riff + 4, 4);
+      uint64_t offset = sizeof(riff);
+      bool foundFmt = false;
+      uint32_t size = 0;
+      for (;;)
+      {
+        char chunk[8];
+        if (!readExact(chunk, sizeof(chunk)))
+        {
+          std::cerr << "Couldn't find 'data' subchunk." << std::endl;
+          return false;
+        }
+        std::memcpy(&size, chunk + 4, 4);
+        offset += sizeof(chunk);
+        if (std::strncmp(chunk, "data", 4) == 0)
+          break;
+        uint64_t skip = static_cast<uint64_t>(size) + (size & 1); // chunks are padded to even sizes
+        if (std::strncmp(chunk, "fmt ", 4) == 0)
+        {
+          char fmt[16];
+          if (size < sizeof(fmt) || !readExact(fmt, sizeof(fmt)))
+          {
+            std::cerr << "Truncated 'fmt ' subchunk." << std::endl;
+            return false;
+          }
+          std::memcpy(&info_.num_channels, fmt + 2, 2);
+          std::memcpy(&info_.sample_rate, fmt + 4, 4);
+          std::memcpy(&info_.block_align, fmt + 12, 2);
+          std::memcpy(&info_.bits_per_sample, fmt + 14, 2);
+          skip -= sizeof(fmt);
+          foundFmt = true;
+        }
+        if (!discard(skip))
+        {
+          std::cerr << "Stream ended inside a subchunk." << std::endl;
+          return false;
+        }
+        offset += static_cast<uint64_t>(size) + (size & 1);
+      }
+      if (!foundFmt)
+      {
+        std::cerr << "Couldn't find 'fmt ' subchunk before 'data'." << std::endl;
+        return false;
+      }
+      if (info_.block_align == 0)
+      {
+        std::cerr << "BlockAlign must not be 0." << std::endl;
+        return false;
+      }
+      info_.data_size = size;
+      info_.data_offset = offset;
+      length_known_ = size != 0 && size != kUnknownSize;
+      info_.num_samples = length_known_ ? size / info_.block_align : 0;
+      remaining_ = length_known_ ? size : std::numeric_limits<uint64_t>::max();
+      return true;
+    }
+
+    // Format of the stream. num_samples is 0 when the length is unknown.
+    const WavInfo &info() const { return info_; }
+    bool length_known() const { return length_known_; }
+    uint64_t frames_read() const { return frames_read_; }
+
+    // Reads up to maxFrames whole frames of interleaved samples into frames,
+    // blocking until they arrive. Returns 0 at the end of the samples; a
+    // trailing partial frame is dropped.
+    uint32_t read(char *frames, uint32_t maxFrames)
+    {
+      const uint64_t blockAlign = info_.block_align;
+      uint64_t want = std::min<uint64_t>(static_cast<uint64_t>(maxFrames) * blockAlign,
+                                         remaining_ / blockAlign * blockAlign);
+      if (want == 0)
+        return 0;
+      in_.read(frames, static_cast<std::streamsize>(want));
+      uint64_t got = static_cast<uint64_t>(in_.gcount());
+      remaining_ = got < want ? 0 : remaining_ - got;
+      uint32_t count = static_cast<uint32_t>(got / blockAlign);
+      frames_read_ += count;
+      return count;
+    }
+
+    // Reads the next block of up to maxFrames frames as a WavFile with this
+    // stream's format. Returns false at the end of the samples.
+    bool next(WavFile &block, uint32_t maxFrames = 4096)
+    {
+      block.setInfo(info_);
+      block.raw_data.resize(static_cast<size_t>(maxFrames) * info_.block_align);
+      block.num_samples = read(block.raw_data.data(), maxFrames);
+      block.data_size = block.num_samples * info_.block_align;
+      block.chunk_size = 36 + block.data_size;
+      block.raw_data.resize(block.data_size);
+      return block.num_samples > 0;
+    }
+
+  private:
+    bool readExact(char *buffer, size_t size)
+    {
+      in_.read(buffer, static_cast<std::streamsize>(size));
+      return static_cast<size_t>(in_.gcount()) == size;
+    }
+
+    bool discard(uint64_t size)
+    {
+      char buffer[4096];
+      while (size > 0)
+      {
+        size_t chunk = static_cast<size_t>(std::min<uint64_t>(size, sizeof(buffer)));
+        if (!readExact(buffer, chunk))
+          return false;
+        size -= chunk;
+      }
+      return true;
+    }
+
+    std::istream &in_;
+    WavInfo info_;
+    bool length_known_ = false;
+    uint64_t remaining_ = 0; // sample bytes left, when known
+    uint64_t frames_read_ = 0;
+  };
+
+  // Writes a WAV stream to a non-seekable output. The header goes out first
+  // with sizes of 0xFFFFFFFF, which WavStreamReader (and most tools) read as
+  // "until end of stream".
+  class WavStreamWriter
+  {
+  public:
+    explicit WavStreamWriter(std::ostream &out) : out_(out) {}
+
+    bool open(uint32_t sample_rate, uint16_t num_channels, uint16_t bits_per_sample)
+    {
+      WavFile header;
+      header.sample_rate = sample_rate;
+      header.num_channels = num_channels;
+      header.bits_per_sample = bits_per_sample;
+      header.chunk_size = WavStreamReader::kUnknownSize;
+      header.data_size = WavStreamReader::kUnknownSize;
+      block_align_ = num_channels * (bits_per_sample / 8);
+      std::array<char, 44> h = header.header();
+      out_.write(h.data(), h.size());
+      return static_cast<bool>(out_);
+    }
+
+    uint16_t block_align() const { return block_align_; }
+
+    // Appends count interleaved frames of block_align() bytes each.
+    bool write(const char *frames, uint32_t count)
+    {
+      out_.write(frames, static_cast<std::streamsize>(count) * block_align_);
+      return static_cast<bool>(out_);
+    }
+
+    bool write(const WavFile &block) { return write(block.raw_data.data(), block.num_samples); }
+
+    bool flush() { return static_cast<bool>(out_.flush()); }
+
+  private:
+    std::ostream &out_;
+    uint16_t block_align_ = 0;
+  };
+
+  //------------------------------------------------------------------------------
+  // WavTailReader: Follows a WAV file that is still being recorded.
+  //------------------------------------------------------------------------------
+  // The header's data size is stale (usually 0) until the recorder closes the
+  // file, so the samples available are taken from the file's actual size,
+  // whole frames at a time. A patched data size (as WavWriter::close writes)
+  // caps reading, so trailing metadata chunks are never read as samples. It
+  // only marks the end once neither it nor the file size has changed for
+  // settleMs, since many recorders rewrite the header periodically while they
+  // are still recording. Growth is waited for with inotify on Linux and by
+  // polling elsewhere.
+  class WavTailReader
+  {
+  public:
+    WavTailReader() = default;
+    WavTailReader(const WavTailReader &) = delete;
+    WavTailReader &operator=(const WavTailReader &) = delete;
+    ~WavTailReader() { close(); }
+
+    // Fails, quietly, if the header isn't complete yet; retry once the
+    // recorder has written it. Without inotify, growth is checked every pollMs.
+    bool open(const std::string &filePath, uint32_t pollMs = 100, uint32_t settleMs = 1000)
+    {
+      close();
+      if (!probe(filePath, info_, true) || !file_.open(filePath, AccessPattern::Sequential))
+        return false;
+      path_ = filePath;
+      poll_ms_ = std::max<uint32_t>(1, pollMs);
+      settle_ms_ = settleMs;
+      consumed_ = 0;
+      final_size_ = 0;
+      patched_ = 0;
+      frames_read_ = 0;
+      finished_ = false;
+#if defined(WAVLIB_POSIX) && defined(__linux__)
+      notify_fd_ = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+      if (notify_fd_ >= 0 && ::inotify_add_watch(notify_fd_, filePath.c_str(), IN_MODIFY | IN_CLOSE_WRITE) < 0)
+      {
+        ::close(notify_fd_);
+        notify_fd_ = -1;
+      }
+#endif
+      return true;
+    }
+
+    void close()
+    {
+      file_.close();
+#if defined(WAVLIB_POSIX) && defined(__linux__)
+      if (notify_fd_ >= 0)
+        ::close(notify_fd_);
+      notify_fd_ = -1;
+#endif
+    }
+
+    // Format of the recording. num_samples reflects the header at open().
+    const WavInfo &info() const { return info_; }
+    uint64_t frames_read() const { return frames_read_; }
+
+    // True once the data size has been patched and every frame read.
+    bool finished() const { return finished_; }
+
+    // Reads up to maxFrames of the whole frames written since the last call,
+    // without waiting. Returns 0 if none are available yet.
+    uint32_t read(char *frames, uint32_t maxFrames)
+    {
+      uint64_t available = dataEnd() - consumed_;
+      uint32_t count = static_cast<uint32_t>(std::min<uint64_t>(available / info_.block_align, maxFrames));
+      size_t bytes = static_cast<size_t>(count) * info_.block_align;
+      if (count > 0 && !file_.readAt(info_.data_offset + consumed_, frames, bytes))
+        return 0;
+      consumed_ += bytes;
+      frames_read_ += count;
+      finished_ = final_size_ && consumed_ + info_.block_align > final_size_;
+      return count;
+    }
+
+    // Returns the next block of up to maxFrames new frames, waiting up to
+    // timeoutMs (-1 = forever) for the recorder to write them. Returns false
+    // when the recording is finished() or the wait timed out.
+    bool next(WavFile &block, uint32_t maxFrames = 4096, int timeoutMs = -1)
+    {
+      auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+      block.setInfo(info_);
+      block.raw_data.resize(static_cast<size_t>(maxFrames) * info_.block_align);
+      for (;;)
+      {
+        block.num_samples = read(block.raw_data.data(), maxFrames);
+        if (block.num_samples > 0 || finished_)
+          break;
+        int waitMs = -1;
+        if (timeoutMs >= 0)
+        {
+          auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+          if (left.count() <= 0)
+            break;
+          waitMs = static_cast<int>(left.count());
+        }
+        if (patched_)
+        {
+          // Wake up when the pending data size would settle, even if the file
+          // doesn't change again.
+          auto settle = std::chrono::duration_cast<std::chrono::milliseconds>(
+              patched_since_ + std::chrono::milliseconds(settle_ms_) - std::chrono::steady_clock::now());
+          int settleMs = static_cast<int>(std::max<int64_t>(1, settle.count() + 1));
+          waitMs = waitMs < 0 ? settleMs : std::min(waitMs, settleMs);
+        }
+        waitForChange(waitMs);
+      }
+      block.data_size = block.num_samples * info_.block_align;
+      block.chunk_size = 36 + block.data_size;
+      block.raw_data.resize(block.data_size);
+      return block.num_samples > 0;
+    }
+
+  private:
+    // End of the readable samples, relative to data_offset: the patched data
+    // size while there is one, otherwise whatever the file holds so far. The
+    // patched size becomes final once it and the file size have held still
+    // for settle_ms_.
+    uint64_t dataEnd()
+    {
+      if (final_size_)
+        return final_size_;
+      detail::FileIdentity id;
+      if (!detail::fileIdentity(path_, id))
+        return consumed_;
+      uint64_t available = id.size > info_.data_offset ? id.size - info_.data_offset : 0;
+      uint32_t patched = 0;
+      if (!file_.readAt(info_.data_offset - 4, reinterpret_cast<char *>(&patched), sizeof(patched)) ||
+          patched == 0 || patched == 0xFFFFFFFF || patched > available)
+      {
+        patched_ = 0;
+        return available;
+      }
+      auto now = std::chrono::steady_clock::now();
+      if (patched != patched_ || id.size != patched_file_size_)
+      {
+        patched_ = patched;
+        patched_file_size_ = id.size;
+        patched_since_ = now;
+      }
+      else if (now - patched_since_ >= std::chrono::milliseconds(settle_ms_))
+        final_size_ = patched;
+      return patched;
+    }
+
+    void waitForChange(int timeoutMs)
+    {
+#if defined(WAVLIB_POSIX) && defined(__linux__)
+      if (notify_fd_ >= 0)
+      {
+        struct pollfd pfd = {notify_fd_, POLLIN, 0};
+        if (::poll(&pfd, 1, timeoutMs) > 0)
+        {
+          char events[4096];
+          while (::read(notify_fd_, events, sizeof(events)) > 0)
+          {
+          }
+        }
+        return;
+      }
+#endif
+      uint32_t ms = timeoutMs < 0 ? poll_ms_ : std::min<uint32_t>(poll_ms_, static_cast<uint32_t>(timeoutMs));
+      std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    }
+
+    std::string path_;
+    WavInfo info_;
+    detail::RandomAccessFile file_;
+    uint32_t poll_ms_ = 100;
+    uint32_t settle_ms_ = 1000;
+    uint64_t consumed_ = 0;   // sample bytes read
+    uint64_t final_size_ = 0; // settled data size, 0 while recording
+    uint64_t patched_ = 0;    // data size in the header, 0 if not patched yet
+    uint64_t patched_file_size_ = 0;
+    std::chrono::steady_clock::time_point patched_since_;
+    uint64_t frames_read_ = 0;
+    bool finished_ = false;
+#if defined(WAVLIB_POSIX) && defined(__linux__)
+    int notify_fd_ = -1;
+#endif
+  };
+
+  //------------------------------------------------------------------------------
+  // SharedWavData<T>: Reference-counted, copy-on-write deinterleaved audio data.
+  //------------------------------------------------------------------------------
+  // Copying a SharedWavData copies two pointers; the channel buffers are shared
+  // and read-only until mutableChannel() is called, which gives the caller a
+  // private copy if anyone else still holds the buffer. Copies may be handed to
+  // other threads; a single instance must not be mutated concurrently, nor
+  // copied while another thread mutates it.
+  template <typename T>
+  class SharedWavData
+  {
+  public:
+    uint32_t sample_rate = 0;
+    uint16_t num_channels = 0;
+    uint16_t bits_per_sample = 0;
+    uint32_t num_samples = 0; // per channel
+
+    SharedWavData() = default;
+
+    // Takes over the channel buffers of a WavData; pass an rvalue to avoid a copy.
+    explicit SharedWavData(WavData<T> data)
+    {
+      sample_rate = data.sample_rate;
+      num_channels = data.num_channels;
+      bits_per_sample = data.bits_per_sample;
+      num_samples = data.num_samples;
+      channels_[0] = std::make_shared<std::vector<T>>(std::move(data.channel1));
+      channels_[1] = std::make_shared<std::vector<T>>(std::move(data.channel2));
+    }
+
+    // Read-only access to a channel (0 = left/mono, 1 = right).
+    const std::vector<T> &channel(uint16_t channel) const
+    {
+      static const std::vector<T> empty;
+      return channel < 2 && channels_[channel] ? *channels_[channel] : empty;
+    }
+
+    // Writable access to a channel, detaching it from other holders first.
+    // Only this instance can hold a new reference to its buffer, so once the
+    // count reads 1 it stays 1; the fence orders our writes after the reads
+    // other holders made before releasing. An out-of-range channel is reported
+    // and gets a scratch vector whose contents are discarded.
+    std::vector<T> &mutableChannel(uint16_t channel)
+    {
+      if (channel >= std::min<uint16_t>(num_channels, 2))
+      {
+        std::cerr << "Channel " << channel << " out of range for " << num_channels << " channels." << std::endl;
+        static thread_local std::vector<T> scratch;
+        scratch.clear();
+        return scratch;
+      }
+      std::shared_ptr<std::vector<T>> &buffer = channels_[channel];
+      if (!buffer)
+        buffer = std::make_shared<std::vector<T>>();
+      else if (buffer.use_count() > 1)
+        buffer = std::make_shared<std::vector<T>>(*buffer);
+      else
+        std::atomic_thread_fence(std::memory_order_acquire);
+      return *buffer;
+    }
+
+    // True if the channel buffer is currently shared with another instance.
+    bool isShared(uint16_t channel) const
+    {
+      return channel < 2 && channels_[channel] && channels_[channel].use_count() > 1;
+    }
+
+    // Returns a non-owning planar view of all samples.
+    WavView<T> view() const
+    {
+      WavView<T> v;
+      v.sample_rate = sample_rate;
+      v.num_channels = num_channels;
+      v.bits_per_sample = bits_per_sample;
+      v.num_samples = num_samples;
+      v.channel1 = channel(0).data();
+      if (num_channels == 2)
+        v.channel2 = channel(1).data();
+      return v;
+    }
+
+    // Returns a non-owning view of count samples starting at start (no copy).
+    WavView<T> slice(uint32_t start, uint32_t count) const
+    {
+      return view().slice(start, count);
+    }
+
+    // Copies the samples out into an independent WavData.
+    WavData<T> toWavData() const
+    {
+      return WavData<T>(view());
+    }
+
+    WavFile toWavFile() const
+    {
+      return view().toWavFile();
+    }
+
+    bool save(const std::string &filePath) const
+    {
+      return view().save(filePath);
+    }
+
+  private:
+    std::shared_ptr<std::vector<T>> channels_[2];
+  };
+
+  //------------------------------------------------------------------------------
+  // LazyWavData<T>: Keeps the interleaved WavFile and deinterleaves on demand.
+  //------------------------------------------------------------------------------
+  // Channels are materialized in pages of kPageFrames frames the first time a
+  // range touching them is requested, and cached for later calls. Supports any
+  // channel count. Not thread-safe: guard concurrent access externally.
+  template <typename T>
+  class LazyWavData
+  {
+  public:
+    static constexpr uint32_t kPageFrames = 65536;
+
+    uint32_t sample_rate = 0;
+    uint16_t num_channels = 0;
+    uint16_t bits_per_sample = 0;
+    uint32_t num_samples = 0; // per channel
+
+    LazyWavData() = default;
+
+    // Takes ownership of the file; pass an rvalue to avoid copying raw_data.
+    explicit LazyWavData(WavFile wf) : source_(std::move(wf))
+    {
+      sample_rate = source_.sample_rate;
+      num_channels = source_.num_channels;
+      bits_per_sample = source_.bits_per_sample;
+      if (bits_per_sample != sizeof(T) * 8)
+      {
+        std::cerr << "Bit depth mismatch: file has " << bits_per_sample
+                  << " bits, but T is " << (sizeof(T) * 8) << " bits." << std::endl;
+        return;
+      }
+      num_samples = source_.num_samples;
+      channels_.resize(num_channels);
+    }
+
+    // The retained interleaved source.
+    const WavFile &source() const { return source_; }
+
+    // A zero-copy strided view straight over the interleaved source.
+    WavView<T> interleavedView() const { return WavView<T>(source_); }
+
+    // Returns a pointer to count samples of one channel starting at start,
+    // deinterleaving only the pages that haven't been touched yet.
+    const T *channelRange(uint16_t channel, uint32_t start, uint32_t count)
+    {
+      if (channel >= channels_.size() || start > num_samples)
+        return nullptr;
+      if (count > num_samples - start)
+        count = num_samples - start;
+      Channel &ch = channels_[channel];
+      if (!ch.samples)
+      {
+        ch.samples.reset(new T[num_samples]);
+        ch.pages.assign((num_samples + kPageFrames - 1) / kPageFrames, false);
+      }
+      if (count > 0)
+      {
+        uint32_t lastPage = (start + count - 1) / kPageFrames;
+        for (uint32_t page = start / kPageFrames; page <= lastPage; page++)
+        {
+          if (!ch.pages[page])
+          {
+            deinterleavePage(channel, page);
+            ch.pages[page] = true;
+          }
+        }
+      }
+      return ch.samples.get() + start;
+    }
+
+    // Returns a pointer to a whole channel, materializing any remaining pages.
+    const T *channel(uint16_t channel)
+    {
+      return channelRange(channel, 0, num_samples);
+    }
+
+    // Returns a planar view of count frames starting at start, materializing
+    // only that range of the left and (if stereo) right channels.
+    WavView<T> slice(uint32_t start, uint32_t count)
+    {
+      WavView<T> v;
+      v.sample_rate = sample_rate;
+      v.num_channels = num_channels;
+      v.bits_per_sample = bits_per_sample;
+      if (start > num_samples)
+        start = num_samples;
+      v.num_samples = std::min(count, num_samples - start);
+      if (channels_.empty())
+        return v;
+      v.channel1 = channelRange(0, start, v.num_samples);
+      if (num_channels == 2)
+        v.channel2 = channelRange(1, start, v.num_samples);
+      return v;
+    }
+
+    // Materializes everything into an owning WavData.
+    WavData<T> toWavData()
+    {
+      return WavData<T>(slice(0, num_samples));
+    }
+
+  private:
+    struct Channel
+    {
+      std::unique_ptr<T[]> samples; // default-initialized, so untouched pages cost nothing
+      std::vector<bool> pages;
+    };
+
+    void deinterleavePage(uint16_t channel, uint32_t page)
+    {
+      uint32_t begin = page * kPageFrames;
+      uint32_t end = std::min(begin + kPageFrames, num_samples);
+      T *dest = channels_[channel].samples.get() + begin;
+      const char *src = source_.raw_data.data() + static_cast<size_t>(begin) * source_.block_align +
+                        channel * sizeof(T);
+      if (source_.block_align != num_channels * sizeof(T))
+      {
+        detail::extractChannel<T, 0>(src, end - begin, source_.block_align, dest);
+        return;
+      }
+      detail::dispatchChannels(num_channels, [&](auto channels)
+                               { detail::extractChannel<T, decltype(channels)::value>(
+                                     src, end - begin, source_.block_align, dest); });
+    }
+
+    WavFile source_;
+    std::vector<Channel> channels_;
+  };
+
+  //------------------------------------------------------------------------------
+  // readParallel: Loads one large file with concurrent positional reads.
+  //------------------------------------------------------------------------------
+  // The data chunk is cut into ranges of about rangeBytes (whole frames), which
+  // `threads` workers (0 = hardware concurrency) read with pread() from one
+  // shared descriptor, keeping that many requests in flight at the device.
+  namespace detail
+  {
+    inline uint64_t rangeLength(uint16_t blockAlign, uint64_t rangeBytes)
+    {
+      return std::max<uint64_t>(1, rangeBytes / blockAlign) * blockAlign;
+    }
+
+    // Resizes an output buffer, discarding its contents. A new allocation has
+    // its pages faulted in by `threads` workers first, so the zero fill that
+    // resize() does on this thread doesn't also take every page fault. Needs
+    // MADV_POPULATE_WRITE (Linux 5.14); elsewhere it is a plain resize().
+    template <typename V>
+    void resizePrefaulted(V &v, size_t size, unsigned threads)
+    {
+#if defined(WAVLIB_POSIX) && defined(MADV_POPULATE_WRITE)
+      if (size > v.capacity())
+      {
+        V().swap(v);
+        v.reserve(size);
+        const uintptr_t page = static_cast<uintptr_t>(::sysconf(_SC_PAGESIZE));
+        const uintptr_t start = reinterpret_cast<uintptr_t>(v.data());
+        const uintptr_t begin = (start + page - 1) & ~(page - 1);
+        const uintptr_t end = (start + size * sizeof(typename V::value_type)) & ~(page - 1);
+        const uintptr_t chunk = static_cast<uintptr_t>(64) << 20;
+        if (end > begin)
+          parallelFor(static_cast<size_t>((end - begin + chunk - 1) / chunk), threads, [&](size_t i)
+                      {
+                        uintptr_t from = begin + i * chunk;
+                        ::madvise(reinterpret_cast<void *>(from), std::min(chunk, end - from), MADV_POPULATE_WRITE);
+                      });
+      }
+#else
+      (void)threads;
+#endif
+      v.resize(size);
+    }
+  } // namespace detail
+
+  // Reads straight into out.raw_data: each range lands in its final place.
+  inline bool readParallel(const std::string &filePath, WavFile &out, unsigned threads = 0,
+                           uint64_t rangeBytes = 16 << 20)
+  {
+    WavInfo info;
+    detail::RandomAccessFile file;
+    if (!probe(filePath, info) || !file.open(filePath))
+      return false;
+    out.setInfo(info);
+    detail::resizePrefaulted(out.raw_data, info.data_size, threads);
+    const uint64_t length = detail::rangeLength(info.block_align, rangeBytes);
+    const size_t ranges = static_cast<size_t>((info.data_size + length - 1) / length);
+    std::atomic<bool> ok(true);
+    auto readRange = [&](size_t r)
+    {
+      uint64_t begin = r * length;
+      size_t size = static_cast<size_t>(std::min<uint64_t>(length, info.data_size - begin));
+      if (!file.readAt(info.data_offset + begin, out.raw_data.data() + begin, size))
+        ok = false;
+    };
+    detail::parallelFor(ranges, threads, readRange);
+    if (!ok)
+      std::cerr << "Couldn't read samples from: " << filePath << std::endl;
+    return ok;
+  }
+
+  // Reads and deinterleaves in one pass: each worker reads its range in
+  // cache-sized pieces and splits them into the channels of out, so the
+  // interleaved file is never held in memory.
+  template <typename T>
+  bool readParallel(const std::string &filePath, WavData<T> &out, unsigned threads = 0,
+                    uint64_t rangeBytes = 16 << 20)
+  {
+    WavInfo info;
+    detail::RandomAccessFile file;
+    if (!probe(filePath, info) || !file.open(filePath))
+      return false;
+    if (info.bits_per_sample != sizeof(T) * 8)
+    {
+      std::cerr << "Bit depth mismatch: file has " << info.bits_per_sample
+                << " bits, but T is " << (sizeof(T) * 8) << " bits." << std::endl;
+      return false;
+    }
+    out.sample_rate = info.sample_rate;
+    out.num_channels = info.num_channels;
+    out.bits_per_sample = info.bits_per_sample;
+    out.num_samples = info.num_samples;
+    detail::resizePrefaulted(out.channel1, info.num_samples, threads);
+    detail::resizePrefaulted(out.channel2, info.num_channels == 2 ? info.num_samples : 0, threads);
+    const uint32_t rangeFrames = static_cast<uint32_t>(std::min<uint64_t>(
+        detail::rangeLength(info.block_align, rangeBytes) / info.block_align, std::max<uint32_t>(1, info.num_samples)));
+    const uint32_t pieceFrames = std::max<uint32_t>(1, (1u << 20) / info.block_align);
+    const size_t ranges = (static_cast<size_t>(info.num_samples) + rangeFrames - 1) / rangeFrames;
+    const bool packed = info.block_align == info.num_channels * sizeof(T);
+    std::atomic<bool> ok(true);
+    auto readRange = [&](size_t r)
+    {
+      uint32_t first = static_cast<uint32_t>(r * rangeFrames);
+      uint32_t end = static_cast<uint32_t>(std::min<uint64_t>(info.num_samples, static_cast<uint64_t>(first) + rangeFrames));
+      std::vector<char> piece(static_cast<size_t>(std::min(pieceFrames, end - first)) * info.block_align);
+      for (uint32_t start = first; ok && start < end; start += pieceFrames)
+      {
+        uint32_t frames = std::min(pieceFrames, end - start);
+        if (!file.readAt(info.data_offset + static_cast<uint64_t>(start) * info.block_align, piece.data(),
+                         static_cast<size_t>(frames) * info.block_align))
+        {
+          ok = false;
+          return;
+        }
+        T *left = out.channel1.data() + start;
+        T *right = info.num_channels == 2 ? out.channel2.data() + start : nullptr;
+        if (!packed)
+          detail::deinterleave<T, 0>(piece.data(), frames, info.block_align, left, right);
+        else
+          detail::dispatchChannels(info.num_channels, [&](auto channels)
+                                   { detail::deinterleave<T, decltype(channels)::value>(
+                                         piece.data(), frames, info.block_align, left, right); });
+      }
+    };
+    detail::parallelFor(ranges, threads, readRange);
+    if (!ok)
+      std::cerr << "Couldn't read samples from: " << filePath << std::endl;
+    return ok;
+  }
+
+  //------------------------------------------------------------------------------
+  // Resample: Resamples a WavData<T> or WavView<T> to a new sample rate using linear
+  // interpolation.
+  //------------------------------------------------------------------------------
+  namespace detail
+  {
+    // Linear interpolation of the left and, when Channels == 2, right channel.
+    template <typename T, uint16_t Channels>
+    void resampleLinear(const WavView<T> &input, double ratio, uint32_t frames, T *left, T *right)
+    {
+      const size_t stride = input.stride;
+      for (uint32_t i = 0; i < frames; i++)
+      {
+        double src_index = i / ratio;
+        uint32_t index0 = static_cast<uint32_t>(std::floor(src_index));
+        uint32_t index1 = (index0 + 1 < input.num_samples) ? index0 + 1 : index0;
+        double frac = src_index - index0;
+        double s0 = static_cast<double>(input.channel1[index0 * stride]);
+        double s1 = static_cast<double>(input.channel1[index1 * stride]);
+        left[i] = static_cast<T>(std::round((1.0 - frac) * s0 + frac * s1));
+        if constexpr (Channels == 2)
+        {
+          double t0 = static_cast<double>(input.channel2[index0 * stride]);
+          double t1 = static_cast<double>(input.channel2[index1 * stride]);
+          right[i] = static_cast<T>(std::round((1.0 - frac) * t0 + frac * t1));
+        }
+      }
+      (void)right;
+    }
+
+    // Linear interpolation of every channel of interleaved frames. With Channels
+    // != 0 the per-frame channel loop has a constant trip count and unrolls.
+    template <typename T, uint16_t Channels>
+    void resampleInterleaved(const char *src, uint32_t srcFrames, size_t srcBlockAlign,
+                             uint16_t numChannels, double ratio, uint32_t frames, char *dest)
+    {
+      const uint16_t channels = Channels ? Channels : numChannels;
+      const size_t inStep = Channels ? Channels * sizeof(T) : srcBlockAlign;
+      const size_t outStep = channels * sizeof(T);
+      for (uint32_t i = 0; i < frames; i++)
+      {
+        double src_index = i / ratio;
+        uint32_t index0 = static_cast<uint32_t>(std::floor(src_index));
+        uint32_t index1 = (index0 + 1 < srcFrames) ? index0 + 1 : index0;
+        double frac = src_index - index0;
+        const char *frame0 = src + index0 * inStep;
+        const char *frame1 = src + index1 * inStep;
+        char *out = dest + i * outStep;
+        for (uint16_t c = 0; c < channels; c++)
+        {
+          T s0, s1;
+          std::memcpy(&s0, frame0 + c * sizeof(T), sizeof(T));
+          std::memcpy(&s1, frame1 + c * sizeof(T), sizeof(T));
+          T result = static_cast<T>(std::round((1.0 - frac) * s0 + frac * s1));
+          std::memcpy(out + c * sizeof(T), &result, sizeof(T));
+        }
+      }
+    }
+  } // namespace detail
+
+  template <typename T>
+  WavData<T> resample(const WavView<T> &input, uint32_t new_sample_rate)
+  {
+    WavData<T> output;
+    output.sample_rate = new_sample_rate;
+    output.num_channels = input.num_channels;
+    output.bits_per_sample = input.bits_per_sample;
+    double ratio = static_cast<double>(new_sample_rate) / input.sample_rate;
+    uint32_t newNumSamples = static_cast<uint32_t>(input.num_samples * ratio);
+    output.num_samples = newNumSamples;
+    output.channel1.resize(newNumSamples);
+    if (input.num_channels == 2)
+    {
+      output.channel2.resize(newNumSamples);
+      detail::resampleLinear<T, 2>(input, ratio, newNumSamples, output.channel1.data(), output.channel2.data());
+    }
+    else
+    {
+      detail::resampleLinear<T, 1>(input, ratio, newNumSamples, output.channel1.data(), nullptr);
+    }
+    return output;
+  }
+
+  template <typename T>
+  WavData<T> resample(const WavData<T> &input, uint32_t new_sample_rate)
+  {
+    return resample(input.view(), new_sample_rate);
+  }
+
+  // Resamples interleaved WavFile data directly, for any channel count, without
+  // deinterleaving into a WavData first.
+  template <typename T>
+  WavFile resample(const WavFile &input, uint32_t new_sample_rate)
+  {
+    WavFile output;
+    if (input.bits_per_sample != sizeof(T) * 8)
+    {
+      std::cerr << "Bit depth mismatch: file has " << input.bits_per_sample
+                << " bits, but T is " << (sizeof(T) * 8) << " bits." << std::endl;
+      return output;
+    }
+    output.sample_rate = new_sample_rate;
+    output.num_channels = input.num_channels;
+    output.bits_per_sample = input.bits_per_sample;
+    output.block_align = input.num_channels * sizeof(T);
+    double ratio = static_cast<double>(new_sample_rate) / input.sample_rate;
+    output.num_samples = static_cast<uint32_t>(input.num_samples * ratio);
+    output.data_size = output.num_samples * output.block_align;
+    output.chunk_size = 36 + output.data_size;
+    output.raw_data.resize(output.data_size);
+    const char *src = input.raw_data.data();
+    char *dest = output.raw_data.data();
+    auto run = [&](auto channels)
+    {
+      detail::resampleInterleaved<T, decltype(channels)::value>(
+          src, input.num_samples, input.block_align, input.num_channels, ratio, output.num_samples, dest);
+    };
+    if (input.block_align == output.block_align)
+      detail::dispatchChannels(input.num_channels, run);
+    else
+      run(detail::ChannelCount<0>());
+    return output;
+  }
+
+  //------------------------------------------------------------------------------
+  // convertSample: Converts a sample from type From to type To (distinguishing signed/unsigned).
+  //------------------------------------------------------------------------------
+  template <typename From, typename To>
+  To convertSample(From sample)
+  {
+    double fSample = static_cast<double>(sample);
+    double fromMin, fromMax, toMin, toMax;
+    if constexpr (std::is_signed<From>::value)
+    {
+      fromMin = static_cast<double>(std::numeric_limits<From>::min());
+      fromMax = static_cast<double>(std::numeric_limits<From>::max());
+    }
+    else
+    {
+      fromMin = 0.0;
+      fromMax = static_cast<double>(std::numeric_limits<From>::max());
+    }
+    if constexpr (std::is_signed<To>::value)
+    {
+      toMin = static_cast<double>(std::numeric_limits<To>::min());
+      toMax = static_cast<double>(std::numeric_limits<To>::max());
+    }
+    else
+    {
+      toMin = 0.0;
+      toMax = static_cast<double>(std::numeric_limits<To>::max());
+    }
+    double normalized = (fSample - fromMin) / (fromMax - fromMin);
+    double result = normalized * (toMax - toMin) + toMin;
+    return static_cast<To>(std::round(result));
+  }
+
+  //------------------------------------------------------------------------------
+  // Reencode: Converts a WavData or WavView from one sample type to another.
+  //------------------------------------------------------------------------------
+  template <typename From, typename To>
+  WavData<To> reencode(const WavView<From> &input)
+  {
+    WavData<To> output;
+    output.sample_rate = input.sample_rate;
+    output.num_channels = input.num_channels;
+    output.num_samples = input.num_samples;
+    output.bits_per_sample = sizeof(To) * 8;
+    output.channel1.resize(input.num_samples);
+    if (input.num_channels == 2)
+      output.channel2.resize(input.num_samples);
+    // One branch-free pass per channel.
+    const size_t stride = input.stride;
+    auto convertChannel = [&](const From *src, To *dest)
+    {
+      for (uint32_t i = 0; i < input.num_samples; i++)
+        dest[i] = convertSample<From, To>(src[i * stride]);
+    };
+    convertChannel(input.channel1, output.channel1.data());
+    if (input.num_channels == 2)
+      convertChannel(input.channel2, output.channel2.data());
+    return output;
+  }
+
+  template <typename From, typename To>
+  WavData<To> reencode(const WavData<From> &input)
+  {
+    return reencode<From, To>(input.view());
+  }
+
+  // Reencodes interleaved WavFile data directly, for any channel count, in a single
+  // pass over the source and destination buffers. Source frames are read at
+  // block_align, so padding after the samples of a frame is dropped.
+  template <typename From, typename To>
+  WavFile reencode(const WavFile &input)
+  {
+    WavFile output;
+    if (input.bits_per_sample != sizeof(From) * 8)
+    {
+      std::cerr << "Bit depth mismatch: file has " << input.bits_per_sample
+                << " bits, but From is " << (sizeof(From) * 8) << " bits." << std::endl;
+      return output;
+    }
+    output.sample_rate = input.sample_rate;
     output.num_channels = input.num_channels;
-    output.num_samples = input.num_samples;
     output.bits_per_sample = sizeof(To) * 8;
-    output.channel1.resize(input.num_samples);
-    if (input.num_channels == 2)
-      output.channel2.resize(input.num_samples);
+    output.block_align = input.num_channels * sizeof(To);
+    output.num_samples = input.num_samples;
+    output.data_size = output.num_samples * output.block_align;
+    output.chunk_size = 36 + output.data_size;
+    output.raw_data.resize(output.data_size);
+    const char *src = input.raw_data.data();
+    char *dest = output.raw_data.data();
+    for (uint32_t f = 0; f < input.num_samples; f++)
+    {
+      const char *frame = src + static_cast<size_t>(f) * input.block_align;
+      for (uint16_t c = 0; c < input.num_channels; c++, dest += sizeof(To))
+      {
+        From in;
+        std::memcpy(&in, frame + c * sizeof(From), sizeof(From));
+        To out = convertSample<From, To>(in);
+        std::memcpy(dest, &out, sizeof(To));
+      }
+    }
+    return output;
+  }
+
+  // Runtime-dispatched entry points for WavFile data: pick the sample types
+  // from the header and forward to the specialized kernels above.
+  inline WavFile reencode(const WavFile &input, uint16_t new_bits_per_sample)
+  {
+    WavFile output;
+    detail::dispatchFormat(input.bits_per_sample, [&](auto from)
+                           { detail::dispatchFormat(new_bits_per_sample, [&](auto to)
+                                                    { output = reencode<decltype(from), decltype(to)>(input); }); });
+    return output;
+  }
+
+  inline WavFile resample(const WavFile &input, uint32_t new_sample_rate)
+  {
+    WavFile output;
+    detail::dispatchFormat(input.bits_per_sample, [&](auto type)
+                           { output = resample<decltype(type)>(input, new_sample_rate); });
+    return output;
+  }
+
+  //------------------------------------------------------------------------------
+  // Level operations: Gain and peak measurement on WavData, WavView and WavFile.
+  //------------------------------------------------------------------------------
+  namespace detail
+  {
+    constexpr double kPi = 3.14159265358979323846;
+
+    // The value of silence: 0 for signed and floating-point formats, 128 for
+    // unsigned 8-bit PCM.
+    template <typename T>
+    constexpr double zeroPoint()
+    {
+      if constexpr (std::is_floating_point<T>::value || std::is_signed<T>::value)
+        return 0.0;
+      else
+        return static_cast<double>(std::numeric_limits<T>::max() / 2 + 1);
+    }
+
+    // Distance from the zero point to negative full scale; 1.0 for float
+    // samples, which are nominally in [-1, 1].
+    template <typename T>
+    constexpr double fullScale()
+    {
+      if constexpr (std::is_floating_point<T>::value)
+        return 1.0;
+      else if constexpr (std::is_signed<T>::value)
+        return -static_cast<double>(std::numeric_limits<T>::min());
+      else
+        return zeroPoint<T>();
+    }
+
+    // Rounds and clamps a value to the representable range of T. Float
+    // samples are clamped to [-1, 1] and not rounded.
+    template <typename T>
+    constexpr T clampSample(double value)
+    {
+      if constexpr (std::is_floating_point<T>::value)
+        return static_cast<T>(value < -1.0 ? -1.0 : value > 1.0 ? 1.0 : value);
+      else
+      {
+        double lo = static_cast<double>(std::numeric_limits<T>::lowest());
+        double hi = static_cast<double>(std::numeric_limits<T>::max());
+        if (value < lo)
+          value = lo;
+        if (value > hi)
+          value = hi;
+        return static_cast<T>(std::round(value));
+      }
+    }
+
+    // Scales a sample around its format's zero point (unsigned 8-bit PCM is
+    // centred on 128), clamping to the representable range.
+    template <typename T>
+    T scaleSample(T sample, double gain)
+    {
+      return clampSample<T>((static_cast<double>(sample) - zeroPoint<T>()) * gain + zeroPoint<T>());
+    }
+
+    // Returns |sample| relative to full scale, in [0, 1].
+    template <typename T>
+    double normalizedMagnitude(T sample)
+    {
+      return std::fabs(static_cast<double>(sample) - zeroPoint<T>()) / fullScale<T>();
+    }
+
+    // Dot product with eight independent partial sums, which lets the compiler
+    // vectorize it without -ffast-math.
+    inline float dotProduct(const float *a, const float *b, size_t n)
+    {
+      float acc[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+      size_t i = 0;
+      for (; i + 8 <= n; i += 8)
+        for (size_t k = 0; k < 8; k++)
+          acc[k] += a[i + k] * b[i + k];
+      float sum = ((acc[0] + acc[1]) + (acc[2] + acc[3])) + ((acc[4] + acc[5]) + (acc[6] + acc[7]));
+      for (; i < n; i++)
+        sum += a[i] * b[i];
+      return sum;
+    }
+
+    // Converts a sample to a float in [-1, 1) and back.
+    template <typename T>
+    constexpr float sampleToFloat(T sample)
+    {
+      return static_cast<float>((static_cast<double>(sample) - zeroPoint<T>()) / fullScale<T>());
+    }
+
+    template <typename T>
+    constexpr T floatToSample(double value)
+    {
+      return clampSample<T>(value * fullScale<T>() + zeroPoint<T>());
+    }
+
+    // Float clips (planar bundle clips, .npy arrays) pass through unchanged.
+    static_assert(sampleToFloat(-0.5f) == -0.5f && floatToSample<float>(-0.5) == -0.5f &&
+                      floatToSample<float>(sampleToFloat(0.25f)) == 0.25f && clampSample<float>(-2.0) == -1.0f &&
+                      fullScale<float>() == 1.0 && zeroPoint<float>() == 0.0,
+                  "float samples must map to themselves");
+  } // namespace detail
+
+  // Multiplies every sample by gain (linear), clamping at full scale.
+  template <typename T>
+  void applyGain(WavData<T> &data, double gain)
+  {
+    for (T &s : data.channel1)
+      s = detail::scaleSample(s, gain);
+    for (T &s : data.channel2)
+      s = detail::scaleSample(s, gain);
+  }
+
+  // Multiplies every interleaved sample of a WavFile in place, for any channel
+  // count; frame padding is left untouched.
+  template <typename T>
+  bool applyGain(WavFile &file, double gain)
+  {
+    if (file.bits_per_sample != sizeof(T) * 8)
+    {
+      std::cerr << "Bit depth mismatch: file has " << file.bits_per_sample
+                << " bits, but T is " << (sizeof(T) * 8) << " bits." << std::endl;
+      return false;
+    }
+    for (uint32_t f = 0; f < file.num_samples; f++)
+    {
+      char *frame = file.raw_data.data() + static_cast<size_t>(f) * file.block_align;
+      for (uint16_t c = 0; c < file.num_channels; c++)
+      {
+        T s;
+        std::memcpy(&s, frame + c * sizeof(T), sizeof(T));
+        s = detail::scaleSample(s, gain);
+        std::memcpy(frame + c * sizeof(T), &s, sizeof(T));
+      }
+    }
+    return true;
+  }
+
+  // Returns the peak absolute level of a view relative to full scale, in [0, 1].
+  template <typename T>
+  double peakLevel(const WavView<T> &input)
+  {
+    double peak = 0.0;
     for (uint32_t i = 0; i < input.num_samples; i++)
     {
-      output.channel1[i] = convertSample<From, To>(input.channel1[i]);
-      if (input.num_channels == 2)
-        output.channel2[i] = convertSample<From, To>(input.channel2[i]);
+      peak = std::max(peak, detail::normalizedMagnitude(input.sample(0, i)));
+      if (input.num_channels == 2)
+        peak = std::max(peak, detail::normalizedMagnitude(input.sample(1, i)));
+    }
+    return peak;
+  }
+
+  template <typename T>
+  double peakLevel(const WavData<T> &input)
+  {
+    return peakLevel(input.view());
+  }
+
+  // Returns the peak level over all interleaved channels of a WavFile.
+  template <typename T>
+  double peakLevel(const WavFile &file)
+  {
+    double peak = 0.0;
+    if (file.bits_per_sample != sizeof(T) * 8)
+    {
+      std::cerr << "Bit depth mismatch: file has " << file.bits_per_sample
+                << " bits, but T is " << (sizeof(T) * 8) << " bits." << std::endl;
+      return peak;
+    }
+    for (uint32_t f = 0; f < file.num_samples; f++)
+    {
+      const char *frame = file.raw_data.data() + static_cast<size_t>(f) * file.block_align;
+      for (uint16_t c = 0; c < file.num_channels; c++)
+      {
+        T s;
+        std::memcpy(&s, frame + c * sizeof(T), sizeof(T));
+        peak = std::max(peak, detail::normalizedMagnitude(s));
+      }
+    }
+    return peak;
+  }
+
+  //------------------------------------------------------------------------------
+  // Polyphase resampling: Windowed-sinc rate conversion with cached filter tables.
+  //------------------------------------------------------------------------------
+  // A rate change is reduced to up / down (44100 -> 48000 is 160 / 147). Output
+  // frame n sits at input position n * down / up and is the dot product of the
+  // input around it with filter phase (n * down) % up. Each phase holds `taps`
+  // Kaiser-windowed sinc coefficients, low-passed below the lower Nyquist rate
+  // and normalized to unity gain at DC.
+  enum class ResampleQuality
+  {
+    Fast,   // 8 zero crossings each side
+    Medium, // 16
+    High    // 32
+  };
+
+  struct PolyphaseTable
+  {
+    uint32_t up = 1;
+    uint32_t down = 1;
+    uint32_t taps = 0;             // coefficients per phase
+    const float *coeffs = nullptr; // up * taps, phase after phase
+    std::vector<float> storage;    // empty when coeffs is a compile-time table
+
+    PolyphaseTable() = default;
+    PolyphaseTable(const PolyphaseTable &) = delete;
+    PolyphaseTable &operator=(const PolyphaseTable &) = delete;
+
+    const float *phase(uint32_t p) const { return coeffs + static_cast<size_t>(p) * taps; }
+  };
+
+  namespace detail
+  {
+    // <cmath> isn't constexpr in C++17, so the tables use these series instead.
+    // The runtime builder calls the same functions, so a table is bit-identical
+    // whichever way it was made.
+    namespace ct
+    {
+      constexpr double sqrt(double x)
+      {
+        if (x <= 0.0)
+          return 0.0;
+        double r = x < 1.0 ? 1.0 : x;
+        for (int i = 0; i < 64; i++)
+        {
+          double next = 0.5 * (r + x / r);
+          if (next == r)
+            break;
+          r = next;
+        }
+        return r;
+      }
+
+      constexpr double sin(double x)
+      {
+        double turns = x / (2.0 * kPi);
+        x -= static_cast<double>(static_cast<long long>(turns)) * 2.0 * kPi;
+        if (x > kPi)
+          x -= 2.0 * kPi;
+        if (x < -kPi)
+          x += 2.0 * kPi;
+        double term = x, sum = x;
+        for (int n = 1; n < 20; n++)
+        {
+          term *= -x * x / ((2.0 * n) * (2.0 * n + 1.0));
+          sum += term;
+        }
+        return sum;
+      }
+
+      // Modified Bessel function of the first kind, order 0.
+      constexpr double besselI0(double x)
+      {
+        double term = 1.0, sum = 1.0;
+        for (int k = 1; k < 64; k++)
+        {
+          double f = x / (2.0 * k);
+          term *= f * f;
+          sum += term;
+          if (term < sum * 1e-17)
+            break;
+        }
+        return sum;
+      }
+    } // namespace ct
+
+    struct ResampleShape
+    {
+      uint32_t zeroCrossings;
+      double rolloff; // passband edge as a fraction of the lower Nyquist rate
+      double beta;    // Kaiser window shape
+    };
+
+    constexpr ResampleShape resampleShape(ResampleQuality quality)
+    {
+      return quality == ResampleQuality::Fast     ? ResampleShape{8, 0.90, 6.0}
+             : quality == ResampleQuality::Medium ? ResampleShape{16, 0.94, 8.0}
+                                                  : ResampleShape{32, 0.97, 10.0};
+    }
+
+    // Cutoff relative to the input Nyquist rate.
+    constexpr double resampleCutoff(uint32_t up, uint32_t down, ResampleQuality quality)
+    {
+      return resampleShape(quality).rolloff * (up < down ? static_cast<double>(up) / down : 1.0);
+    }
+
+    // Downsampling lowers the cutoff, which widens the sinc; the tap count grows
+    // to keep the same number of zero crossings.
+    constexpr uint32_t resampleTaps(uint32_t up, uint32_t down, ResampleQuality quality)
+    {
+      double span = resampleShape(quality).zeroCrossings / resampleCutoff(up, down, quality);
+      uint32_t half = static_cast<uint32_t>(span);
+      if (half < span)
+        half++;
+      return 2 * half;
+    }
+
+    // Unnormalized coefficient `tap` of phase `phase`. Tap k multiplies input
+    // sample i - taps / 2 + 1 + k for output position i + phase / up.
+    constexpr double resampleCoefficient(uint32_t up, uint32_t down, ResampleQuality quality,
+                                         uint32_t phase, uint32_t tap)
+    {
+      const uint32_t half = resampleTaps(up, down, quality) / 2;
+      const double cutoff = resampleCutoff(up, down, quality);
+      const double beta = resampleShape(quality).beta;
+      double t = (static_cast<double>(half) - 1.0 - tap) + static_cast<double>(phase) / up;
+      double x = t / half;
+      if (x <= -1.0 || x >= 1.0)
+        return 0.0;
+      double window = ct::besselI0(beta * ct::sqrt(1.0 - x * x)) / ct::besselI0(beta);
+      double arg = kPi * cutoff * t;
+      double sinc = t == 0.0 ? 1.0 : ct::sin(arg) / arg;
+      return cutoff * sinc * window;
+    }
+
+    // Writes up * taps normalized coefficients to out.
+    constexpr void fillPolyphase(uint32_t up, uint32_t down, ResampleQuality quality, float *out)
+    {
+      const uint32_t taps = resampleTaps(up, down, quality);
+      for (uint32_t p = 0; p < up; p++)
+      {
+        double sum = 0.0;
+        for (uint32_t k = 0; k < taps; k++)
+          sum += resampleCoefficient(up, down, quality, p, k);
+        for (uint32_t k = 0; k < taps; k++)
+          out[static_cast<size_t>(p) * taps + k] =
+              static_cast<float>(resampleCoefficient(up, down, quality, p, k) / sum);
+      }
+    }
+
+    template <uint32_t Up, uint32_t Down, ResampleQuality Quality>
+    struct StaticPolyphase
+    {
+      static constexpr uint32_t kTaps = resampleTaps(Up, Down, Quality);
+
+      static constexpr std::array<float, Up * kTaps> make()
+      {
+        std::array<float, Up * kTaps> table{};
+        fillPolyphase(Up, Down, Quality, table.data());
+        return table;
+      }
+
+      static constexpr std::array<float, Up * kTaps> coeffs = make();
+    };
+
+    // Compile-time tables: the integer-ratio conversions around 16 and 48 kHz
+    // (and 22.05 / 44.1 kHz) at the default quality.
+    template <uint32_t Up, uint32_t Down>
+    bool adoptStaticPolyphase(PolyphaseTable &table)
+    {
+      if (table.up != Up || table.down != Down)
+        return false;
+      table.taps = StaticPolyphase<Up, Down, ResampleQuality::Medium>::kTaps;
+      table.coeffs = StaticPolyphase<Up, Down, ResampleQuality::Medium>::coeffs.data();
+      return true;
+    }
+
+    inline bool adoptStaticPolyphase(PolyphaseTable &table, ResampleQuality quality)
+    {
+      if (quality != ResampleQuality::Medium)
+        return false;
+      return adoptStaticPolyphase<1, 2>(table) || adoptStaticPolyphase<2, 1>(table) ||
+             adoptStaticPolyphase<1, 3>(table) || adoptStaticPolyphase<3, 1>(table);
+    }
+  } // namespace detail
+
+  // Returns the filter table for converting fromRate to toRate, or nullptr if
+  // either rate is 0. Tables are built once per (ratio, quality) and shared
+  // process-wide. Near-coprime rates make tables of many megabytes, so the
+  // cache keeps at most 64 MB of built tables, dropping the least recently used
+  // (holders keep theirs alive). Safe to call from any thread.
+  inline std::shared_ptr<const PolyphaseTable> polyphaseTable(uint32_t fromRate, uint32_t toRate,
+                                                              ResampleQuality quality = ResampleQuality::Medium)
+  {
+    if (fromRate == 0 || toRate == 0)
+      return nullptr;
+    uint32_t divisor = std::gcd(fromRate, toRate);
+    uint32_t up = toRate / divisor;
+    uint32_t down = fromRate / divisor;
+    using Key = std::tuple<uint32_t, uint32_t, ResampleQuality>;
+    struct Entry
+    {
+      std::shared_ptr<const PolyphaseTable> table;
+      std::list<Key>::iterator use;
+      size_t bytes;
+    };
+    const size_t kCacheBytes = size_t(64) << 20;
+    static std::mutex mutex;
+    static std::map<Key, Entry> tables;
+    static std::list<Key> recent; // most recently used first
+    static size_t cachedBytes = 0;
+    Key key(up, down, quality);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto it = tables.find(key);
+      if (it != tables.end())
+      {
+        recent.splice(recent.begin(), recent, it->second.use);
+        return it->second.table;
+      }
+    }
+    // Build outside the lock so other ratios aren't held up; if two threads
+    // race on the same ratio, the first table stored wins.
+    auto table = std::make_shared<PolyphaseTable>();
+    table->up = up;
+    table->down = down;
+    if (!detail::adoptStaticPolyphase(*table, quality))
+    {
+      table->taps = detail::resampleTaps(up, down, quality);
+      table->storage.resize(static_cast<size_t>(up) * table->taps);
+      detail::fillPolyphase(up, down, quality, table->storage.data());
+      table->coeffs = table->storage.data();
+    }
+    const size_t bytes = table->storage.size() * sizeof(float);
+    if (bytes > kCacheBytes)
+      return table;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto inserted = tables.emplace(key, Entry{table, recent.end(), bytes});
+    if (!inserted.second)
+      return inserted.first->second.table;
+    recent.push_front(key);
+    inserted.first->second.use = recent.begin();
+    cachedBytes += bytes;
+    while (cachedBytes > kCacheBytes)
+    {
+      auto victim = tables.find(recent.back());
+      cachedBytes -= victim->second.bytes;
+      tables.erase(victim);
+      recent.pop_back();
+    }
+    return table;
+  }
+
+  // Resamples with a polyphase windowed-sinc filter: slower than resample()'s
+  // linear interpolation but free of its aliasing and high-frequency droop.
+  template <typename T>
+  WavData<T> resampleSinc(const WavView<T> &input, uint32_t new_sample_rate,
+                          ResampleQuality quality = ResampleQuality::Medium)
+  {
+    WavData<T> output;
+    output.sample_rate = new_sample_rate;
+    output.num_channels = input.num_channels;
+    output.bits_per_sample = input.bits_per_sample;
+    std::shared_ptr<const PolyphaseTable> table = polyphaseTable(input.sample_rate, new_sample_rate, quality);
+    if (!table)
+    {
+      std::cerr << "Invalid sample rate: " << input.sample_rate << " -> " << new_sample_rate << std::endl;
+      return output;
+    }
+    const uint32_t frames = static_cast<uint32_t>(static_cast<uint64_t>(input.num_samples) * table->up / table->down);
+    const uint32_t taps = table->taps;
+    const uint32_t step = table->down / table->up;
+    const uint32_t phaseStep = table->down % table->up;
+    output.num_samples = frames;
+    // Each channel is converted to float once, zero-padded so that every
+    // output frame reads taps contiguous samples.
+    std::vector<float> padded(static_cast<size_t>(input.num_samples) + taps);
+    const uint16_t channels = input.num_channels == 2 ? 2 : 1;
+    for (uint16_t c = 0; c < channels; c++)
+    {
+      std::vector<T> &dest = c == 0 ? output.channel1 : output.channel2;
+      dest.resize(frames);
+      for (uint32_t i = 0; i < input.num_samples; i++)
+        padded[i + taps / 2 - 1] = detail::sampleToFloat(input.sample(c, i));
+      size_t index = 0;
+      uint32_t phase = 0;
+      for (uint32_t n = 0; n < frames; n++)
+      {
+        dest[n] = detail::floatToSample<T>(detail::dotProduct(table->phase(phase), padded.data() + index, taps));
+        index += step;
+        phase += phaseStep;
+        if (phase >= table->up)
+        {
+          phase -= table->up;
+          index++;
+        }
+      }
+    }
+    return output;
+  }
+
+  template <typename T>
+  WavData<T> resampleSinc(const WavData<T> &input, uint32_t new_sample_rate,
+                          ResampleQuality quality = ResampleQuality::Medium)
+  {
+    return resampleSinc(input.view(), new_sample_rate, quality);
+  }
+
+  //------------------------------------------------------------------------------
+  // TimeStretcher<T>: Streaming WSOLA tempo change without altering pitch.
+  //------------------------------------------------------------------------------
+  // Each output frame of frameLength samples is overlap-added at a fixed hop of
+  // frameLength / 2 with a Hann window. Its source position advances by
+  // hop * tempo, refined within +/- searchLength samples to the segment that
+  // best correlates with the natural continuation of the previous one.
+  // tempo > 1 speeds up (shorter output), tempo < 1 slows down. Tempos are
+  // clamped to [kMinTempo, kMaxTempo]; beyond that the output length (and the
+  // buffered input) grows without bound or every frame is skipped.
+  // Mono and stereo only.
+  template <typename T>
+  class TimeStretcher
+  {
+  public:
+    static constexpr double kMinTempo = 0.01;
+    static constexpr double kMaxTempo = 100.0;
+
+    TimeStretcher(uint32_t sample_rate, uint16_t num_channels, double tempo,
+                  double frameMs = 20.0, double searchMs = 10.0)
+        : sampleRate_(sample_rate), numChannels_(num_channels == 2 ? 2 : 1), tempo_(tempo)
+    {
+      // A tempo of 0 would never advance through the input.
+      if (!std::isfinite(tempo) || tempo <= 0.0)
+      {
+        std::cerr << "Tempo must be positive and finite, got " << tempo << std::endl;
+        tempo_ = 1.0;
+        valid_ = false;
+      }
+      else if (tempo < kMinTempo || tempo > kMaxTempo)
+      {
+        tempo_ = std::min(std::max(tempo, kMinTempo), kMaxTempo);
+        std::cerr << "Tempo " << tempo << " is out of range, using " << tempo_ << std::endl;
+      }
+      if (num_channels == 0 || num_channels > 2)
+      {
+        std::cerr << "Can't time-stretch " << num_channels << " channels" << std::endl;
+        valid_ = false;
+      }
+      frameLength_ = std::max<uint32_t>(16, static_cast<uint32_t>(sample_rate * frameMs / 1000.0)) & ~1u;
+      hop_ = frameLength_ / 2;
+      search_ = static_cast<uint32_t>(sample_rate * searchMs / 1000.0);
+      window_.resize(frameLength_);
+      for (uint32_t n = 0; n < frameLength_; n++)
+        window_[n] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * detail::kPi * n / frameLength_));
+      for (uint16_t c = 0; c < numChannels_; c++)
+        ola_[c].assign(frameLength_, 0.0f);
+    }
+
+    // False if constructed with an invalid tempo or channel count; process and
+    // flush then do nothing.
+    bool valid() const { return valid_; }
+
+    // Consumes a block and appends every output frame that is now final to out.
+    void process(const WavView<T> &block, WavData<T> &out)
+    {
+      if (!valid_)
+        return;
+      for (uint16_t c = 0; c < numChannels_; c++)
+      {
+        const T *src = c == 0 ? block.channel1 : block.channel2;
+        std::vector<float> &in = in_[c];
+        size_t base = in.size();
+        in.resize(base + block.num_samples);
+        for (uint32_t i = 0; i < block.num_samples; i++)
+          in[base + i] = static_cast<float>(static_cast<double>(src[static_cast<size_t>(i) * block.stride]) - detail::zeroPoint<T>());
+      }
+      size_t base = mix_.size();
+      mix_.resize(base + block.num_samples);
+      for (uint32_t i = 0; i < block.num_samples; i++)
+        mix_[base + i] = numChannels_ == 2 ? 0.5f * (in_[0][base + i] + in_[1][base + i]) : in_[0][base + i];
+      totalIn_ += block.num_samples;
+      run(out, false);
+    }
+
+    // Processes the remaining input and emits the tail, so the total output is
+    // round(total input / tempo) frames.
+    void flush(WavData<T> &out)
+    {
+      if (!valid_)
+        return;
+      // Zero padding lets the last frames search and overlap past the end.
+      size_t pad = frameLength_ + 2 * search_ + hop_;
+      for (uint16_t c = 0; c < numChannels_; c++)
+        in_[c].resize(in_[c].size() + pad, 0.0f);
+      mix_.resize(mix_.size() + pad, 0.0f);
+      run(out, true);
+      uint64_t target = static_cast<uint64_t>(std::llround(totalIn_ / tempo_));
+      if (totalOut_ < target)
+        emit(out, static_cast<uint32_t>(std::min<uint64_t>(target - totalOut_, frameLength_)));
+    }
+
+  private:
+    // Absolute input frame where output frame k is nominally taken from.
+    int64_t nominalPosition(uint64_t k) const
+    {
+      return static_cast<int64_t>(std::llround(k * hop_ * tempo_));
+    }
+
+    void run(WavData<T> &out, bool flushing)
+    {
+      const int64_t available = static_cast<int64_t>(inStart_ + mix_.size());
+      const int64_t inputEnd = static_cast<int64_t>(totalIn_);
+      uint64_t target = static_cast<uint64_t>(std::llround(totalIn_ / tempo_));
+      while (true)
+      {
+        int64_t nominal = nominalPosition(frame_);
+        if (flushing && nominal >= inputEnd)
+          break;
+        if (nominal + search_ + frameLength_ > available ||
+            (frame_ > 0 && prevPos_ + hop_ + hop_ > available))
+          break;
+        int64_t pos = frame_ == 0 ? 0 : bestPosition(nominal);
+        addFrame(pos);
+        prevPos_ = pos;
+        frame_++;
+        if (!flushing || totalOut_ < target)
+          emit(out, flushing ? static_cast<uint32_t>(std::min<uint64_t>(hop_, target - totalOut_)) : hop_);
+        else
+          shiftOla(hop_);
+      }
+      discardConsumedInput();
+    }
+
+    // Searches nominal +/- search_ for the segment whose first half best matches
+    // (normalized cross-correlation) the samples that followed the previous one.
+    int64_t bestPosition(int64_t nominal) const
+    {
+      const int64_t origin = static_cast<int64_t>(inStart_);
+      const float *target = mix_.data() + (prevPos_ + hop_ - origin);
+      int64_t first = std::max<int64_t>(nominal - search_, origin);
+      int64_t last = nominal + search_;
+      const uint32_t length = hop_;
+      const float *x = mix_.data() + (first - origin);
+      double energy = 0.0;
+      for (uint32_t n = 0; n < length; n++)
+        energy += static_cast<double>(x[n]) * x[n];
+      int64_t best = nominal;
+      double bestScore = -std::numeric_limits<double>::infinity();
+      for (int64_t cand = first; cand <= last; cand++, x++)
+      {
+        double score = detail::dotProduct(target, x, length) / std::sqrt(energy + 1e-9);
+        if (score > bestScore)
+        {
+          bestScore = score;
+          best = cand;
+        }
+        energy += static_cast<double>(x[length]) * x[length] - static_cast<double>(x[0]) * x[0];
+        if (energy < 0.0)
+          energy = 0.0;
+      }
+      return best;
+    }
+
+    void addFrame(int64_t pos)
+    {
+      for (uint16_t c = 0; c < numChannels_; c++)
+      {
+        const float *x = in_[c].data() + (pos - static_cast<int64_t>(inStart_));
+        float *acc = ola_[c].data();
+        // The very first frame has no predecessor to fade against.
+        if (frame_ == 0)
+        {
+          for (uint32_t n = 0; n < hop_; n++)
+            acc[n] += x[n];
+          for (uint32_t n = hop_; n < frameLength_; n++)
+            acc[n] += window_[n] * x[n];
+        }
+        else
+        {
+          for (uint32_t n = 0; n < frameLength_; n++)
+            acc[n] += window_[n] * x[n];
+        }
+      }
+    }
+
+    // Appends the first count finished samples of the overlap buffer to out.
+    void emit(WavData<T> &out, uint32_t count)
+    {
+      if (out.num_samples == 0 && out.channel1.empty())
+      {
+        out.sample_rate = sampleRate_;
+        out.num_channels = numChannels_;
+        out.bits_per_sample = sizeof(T) * 8;
+      }
+      for (uint16_t c = 0; c < numChannels_; c++)
+      {
+        std::vector<T> &dest = c == 0 ? out.channel1 : out.channel2;
+        for (uint32_t n = 0; n < count; n++)
+          dest.push_back(detail::clampSample<T>(ola_[c][n] + detail::zeroPoint<T>()));
+      }
+      out.num_samples += count;
+      totalOut_ += count;
+      shiftOla(hop_);
+    }
+
+    void shiftOla(uint32_t count)
+    {
+      for (uint16_t c = 0; c < numChannels_; c++)
+      {
+        std::vector<float> &acc = ola_[c];
+        std::copy(acc.begin() + count, acc.end(), acc.begin());
+        std::fill(acc.end() - count, acc.end(), 0.0f);
+      }
+    }
+
+    // Drops input that no future frame or correlation target can reach.
+    void discardConsumedInput()
+    {
+      int64_t keep = std::min<int64_t>(nominalPosition(frame_) - search_, prevPos_ + hop_);
+      if (keep <= static_cast<int64_t>(inStart_))
+        return;
+      size_t drop = std::min<size_t>(static_cast<size_t>(keep - inStart_), mix_.size());
+      for (uint16_t c = 0; c < numChannels_; c++)
+        in_[c].erase(in_[c].begin(), in_[c].begin() + drop);
+      mix_.erase(mix_.begin(), mix_.begin() + drop);
+      inStart_ += drop;
+    }
+
+    uint32_t sampleRate_;
+    uint16_t numChannels_;
+    double tempo_;
+    bool valid_ = true;
+    uint32_t frameLength_ = 0;
+    uint32_t hop_ = 0;
+    uint32_t search_ = 0;
+    std::vector<float> window_;
+    std::vector<float> in_[2]; // zero-centred input, from absolute frame inStart_
+    std::vector<float> mix_;   // channel average used for the similarity search
+    std::vector<float> ola_[2];
+    uint64_t inStart_ = 0;
+    uint64_t totalIn_ = 0;
+    uint64_t totalOut_ = 0;
+    uint64_t frame_ = 0;
+    int64_t prevPos_ = 0;
+  };
+
+  // Changes the tempo of a whole clip; tempo 1.25 plays 25% faster at the same pitch.
+  template <typename T>
+  WavData<T> timeStretch(const WavView<T> &input, double tempo)
+  {
+    TimeStretcher<T> stretcher(input.sample_rate, input.num_channels, tempo);
+    WavData<T> output;
+    output.sample_rate = input.sample_rate;
+    output.num_channels = input.num_channels == 2 ? 2 : 1;
+    output.bits_per_sample = sizeof(T) * 8;
+    stretcher.process(input, output);
+    stretcher.flush(output);
+    return output;
+  }
+
+  template <typename T>
+  WavData<T> timeStretch(const WavData<T> &input, double tempo)
+  {
+    return timeStretch(input.view(), tempo);
+  }
+
+  //------------------------------------------------------------------------------
+  // PitchShifter<T>: Streaming pitch shift (time-stretch, then resample).
+  //------------------------------------------------------------------------------
+  // Stretches by the pitch factor with a TimeStretcher, then linearly
+  // interpolates the result back to the original duration. The factor is
+  // clamped like the stretcher's tempo, to about +/- 79 semitones.
+  template <typename T>
+  class PitchShifter
+  {
+  public:
+    PitchShifter(uint32_t sample_rate, uint16_t num_channels, double semitones)
+        : factor_(std::isfinite(semitones) ? std::min(std::max(std::pow(2.0, semitones / 12.0),
+                                                                 TimeStretcher<T>::kMinTempo),
+                                                        TimeStretcher<T>::kMaxTempo)
+                                           : 1.0),
+          stretcher_(sample_rate, num_channels, 1.0 / factor_)
+    {
+      if (!std::isfinite(semitones))
+      {
+        std::cerr << "Pitch shift must be finite, got " << semitones << " semitones" << std::endl;
+        valid_ = false;
+      }
+      valid_ = valid_ && stretcher_.valid() && std::isfinite(factor_) && factor_ > 0.0;
+      pending_.sample_rate = sample_rate;
+      pending_.num_channels = num_channels == 2 ? 2 : 1;
+      pending_.bits_per_sample = sizeof(T) * 8;
+    }
+
+    // False if constructed with an invalid shift; process and flush then do nothing.
+    bool valid() const { return valid_; }
+
+    // Consumes a block and appends every pitch-shifted frame that is now final to out.
+    void process(const WavView<T> &block, WavData<T> &out)
+    {
+      if (!valid_)
+        return;
+      totalIn_ += block.num_samples;
+      stretcher_.process(block, pending_);
+      interpolate(out, false);
+    }
+
+    // Emits the remaining frames, so the output is as long as the input.
+    void flush(WavData<T> &out)
+    {
+      if (!valid_)
+        return;
+      stretcher_.flush(pending_);
+      interpolate(out, true);
+    }
+
+  private:
+    void interpolate(WavData<T> &out, bool flushing)
+    {
+      if (out.num_samples == 0 && out.channel1.empty())
+      {
+        out.sample_rate = pending_.sample_rate;
+        out.num_channels = pending_.num_channels;
+        out.bits_per_sample = pending_.bits_per_sample;
+      }
+      const uint32_t available = pending_.num_samples;
+      while (totalOut_ < (flushing ? totalIn_ : std::numeric_limits<uint64_t>::max()))
+      {
+        uint32_t index0 = static_cast<uint32_t>(pos_);
+        if (index0 + 1 >= available && !(flushing && index0 < available))
+          break;
+        uint32_t index1 = index0 + 1 < available ? index0 + 1 : index0;
+        double frac = pos_ - index0;
+        out.channel1.push_back(static_cast<T>(std::round((1.0 - frac) * pending_.channel1[index0] + frac * pending_.channel1[index1])));
+        if (pending_.num_channels == 2)
+          out.channel2.push_back(static_cast<T>(std::round((1.0 - frac) * pending_.channel2[index0] + frac * pending_.channel2[index1])));
+        out.num_samples++;
+        totalOut_++;
+        pos_ += factor_;
+      }
+      // Keep the sample under pos_ and everything after it.
+      uint32_t drop = std::min(static_cast<uint32_t>(pos_), available);
+      pending_.channel1.erase(pending_.channel1.begin(), pending_.channel1.begin() + drop);
+      if (pending_.num_channels == 2)
+        pending_.channel2.erase(pending_.channel2.begin(), pending_.channel2.begin() + drop);
+      pending_.num_samples -= drop;
+      pos_ -= drop;
+    }
+
+    double factor_;
+    TimeStretcher<T> stretcher_;
+    bool valid_ = true;
+    WavData<T> pending_; // stretched samples not yet interpolated
+    double pos_ = 0.0;
+    uint64_t totalIn_ = 0;
+    uint64_t totalOut_ = 0;
+  };
+
+  // Shifts the pitch of a whole clip by the given number of semitones, keeping its duration.
+  template <typename T>
+  WavData<T> pitchShift(const WavView<T> &input, double semitones)
+  {
+    PitchShifter<T> shifter(input.sample_rate, input.num_channels, semitones);
+    WavData<T> output;
+    shifter.process(input, output);
+    shifter.flush(output);
+    return output;
+  }
+
+  template <typename T>
+  WavData<T> pitchShift(const WavData<T> &input, double semitones)
+  {
+    return pitchShift(input.view(), semitones);
+  }
+
+  //------------------------------------------------------------------------------
+  // Edit decision lists: Splice ranges of many source files into one output.
+  //------------------------------------------------------------------------------
+  struct EdlEntry
+  {
+    std::string source;  // path of the source WAV file
+    uint32_t start = 0;  // first source frame
+    uint32_t count = 0;  // number of source frames
+    double gain = 1.0;   // linear gain applied to this entry
+    uint32_t fade = 0;   // frames crossfaded with the previous entry (fade-in for the first)
+  };
+
+  namespace detail
+  {
+    template <typename T>
+    bool renderEdl(const std::vector<EdlEntry> &entries, const WavInfo &format, WavWriter &writer)
+    {
+      const uint32_t kChunkFrames = 65536;
+      const uint16_t blockAlign = format.block_align;
+      const uint16_t channels = format.num_channels;
+      if (blockAlign != channels * sizeof(T))
+      {
+        std::cerr << "Unsupported BlockAlign for EDL rendering: " << blockAlign << std::endl;
+        return false;
+      }
+      std::vector<char> chunk;
+      std::vector<char> tail, nextTail; // held-back end of the previous entry, gain applied
+      std::string openPath;
+      std::ifstream file;
+      WavInfo info;
+      for (size_t e = 0; e < entries.size(); e++)
+      {
+        const EdlEntry &entry = entries[e];
+        if (entry.source != openPath)
+        {
+          file.close();
+          file.clear();
+          file.open(entry.source, std::ios::binary);
+          if (!file.is_open())
+          {
+            std::cerr << "Couldn't open file: " << entry.source << std::endl;
+            return false;
+          }
+          if (!info.read(file))
+            return false;
+          if (info.num_channels != channels || info.sample_rate != format.sample_rate ||
+              info.bits_per_sample != format.bits_per_sample || info.block_align != blockAlign)
+          {
+            std::cerr << "Format mismatch in EDL source: " << entry.source << std::endl;
+            return false;
+          }
+          openPath = entry.source;
+        }
+        uint32_t start = std::min(entry.start, info.num_samples);
+        uint32_t count = std::min(entry.count, info.num_samples - start);
+        // Crossfade against whatever the previous entry held back; the first
+        // entry fades in from silence.
+        uint32_t tailFrames = static_cast<uint32_t>(tail.size() / blockAlign);
+        uint32_t fade = std::min(count, e == 0 ? entry.fade : tailFrames);
+        if (e > 0 && fade < tailFrames)
+        {
+          // This entry is too short to absorb the whole held-back tail.
+          if (!writer.write(tail.data(), tailFrames - fade))
+            return false;
+          tail.erase(tail.begin(), tail.begin() + static_cast<size_t>(tailFrames - fade) * blockAlign);
+        }
+        uint32_t holdBack = e + 1 < entries.size() ? std::min(entries[e + 1].fade, count - fade) : 0;
+        nextTail.clear();
+        file.clear();
+        file.seekg(static_cast<std::streamoff>(info.data_offset + static_cast<uint64_t>(start) * blockAlign));
+        for (uint32_t pos = 0; pos < count;)
+        {
+          uint32_t frames = std::min(kChunkFrames, count - pos);
+          chunk.resize(static_cast<size_t>(frames) * blockAlign);
+          file.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+          if (static_cast<size_t>(file.gcount()) < chunk.size())
+          {
+            std::cerr << "Unexpected end of data in: " << entry.source << std::endl;
+            return false;
+          }
+          T *samples = reinterpret_cast<T *>(chunk.data());
+          const size_t sampleCount = static_cast<size_t>(frames) * channels;
+          if (entry.gain != 1.0)
+            for (size_t i = 0; i < sampleCount; i++)
+              samples[i] = scaleSample(samples[i], entry.gain);
+          // Mix the fade region: previous tail fades out while this entry fades in.
+          uint32_t mixEnd = pos < fade ? std::min(fade - pos, frames) : 0;
+          const T *prev = reinterpret_cast<const T *>(tail.data());
+          for (uint32_t f = 0; f < mixEnd; f++)
+          {
+            double a = static_cast<double>(pos + f + 1) / (fade + 1);
+            for (uint16_t c = 0; c < channels; c++)
+            {
+              size_t i = static_cast<size_t>(f) * channels + c;
+              double cur = static_cast<double>(samples[i]) - zeroPoint<T>();
+              double old = e == 0 ? 0.0 : static_cast<double>(prev[static_cast<size_t>(pos + f) * channels + c]) - zeroPoint<T>();
+              samples[i] = clampSample<T>(old * (1.0 - a) + cur * a + zeroPoint<T>());
+            }
+          }
+          // Everything before the held-back region goes straight to the writer.
+          uint32_t writeEnd = count - holdBack;
+          uint32_t writable = pos < writeEnd ? std::min(frames, writeEnd - pos) : 0;
+          if (writable > 0 && !writer.write(chunk.data(), writable))
+            return false;
+          nextTail.insert(nextTail.end(), chunk.begin() + static_cast<size_t>(writable) * blockAlign, chunk.end());
+          pos += frames;
+        }
+        tail.swap(nextTail);
+      }
+      if (!tail.empty() && !writer.write(tail.data(), static_cast<uint32_t>(tail.size() / blockAlign)))
+        return false;
+      return true;
+    }
+  } // namespace detail
+
+  // Renders an edit decision list to outPath in a single pass. Only the
+  // referenced frame ranges are read, and memory is bounded by one read chunk
+  // plus the longest crossfade. All sources must share one format. On failure
+  // the partial output is removed.
+  inline bool renderEdl(const std::vector<EdlEntry> &entries, const std::string &outPath)
+  {
+    if (entries.empty())
+    {
+      std::cerr << "EDL is empty." << std::endl;
+      return false;
+    }
+    WavInfo format;
+    if (!probe(entries.front().source, format))
+      return false;
+    WavWriter writer;
+    if (!writer.open(outPath, format.sample_rate, format.num_channels, format.bits_per_sample))
+      return false;
+    bool ok = false;
+    detail::dispatchFormat(format.bits_per_sample, [&](auto type)
+                           { ok = detail::renderEdl<decltype(type)>(entries, format, writer); });
+    ok = writer.close() && ok;
+    if (!ok)
+    {
+      std::error_code ec;
+      std::filesystem::remove(outPath, ec);
+    }
+    return ok;
+  }
+
+  //------------------------------------------------------------------------------
+  // splitFile: Cuts one long file into many output files in parallel.
+  //------------------------------------------------------------------------------
+  struct SplitRange
+  {
+    uint32_t start = 0; // first frame
+    uint32_t count = 0; // number of frames
+    std::string path;   // output file
+  };
+
+  // Writes each range of inPath to its own file. Ranges are read with
+  // positional I/O from one shared descriptor and written by `threads`
+  // workers (0 = hardware concurrency), each holding at most one chunk of
+  // chunkFrames frames (at least one) in memory. Ranges past the end of the
+  // input are clamped. Frames are copied as is, so inputs whose block_align
+  // carries padding are rejected. hints apply to the input (each range is read
+  // front to back, prefetching its next chunk) and to every output file.
+  inline bool splitFile(const std::string &inPath, const std::vector<SplitRange> &ranges,
+                        unsigned threads = 0, uint32_t chunkFrames = 262144,
+                        const IoHints &hints = IoHints())
+  {
+    WavInfo info;
+    if (!probe(inPath, info))
+      return false;
+    if (info.block_align != info.num_channels * (info.bits_per_sample / 8))
+    {
+      std::cerr << "Can't split padded frames (block align " << info.block_align << "): " << inPath << std::endl;
+      return false;
+    }
+    detail::RandomAccessFile file;
+    if (!file.open(inPath, hints.pattern))
+      return false;
+    chunkFrames = std::max<uint32_t>(chunkFrames, 1);
+    std::atomic<bool> ok(true);
+    std::mutex logMutex;
+    auto writeRange = [&](size_t r)
+    {
+      const SplitRange &range = ranges[r];
+      uint32_t start = std::min(range.start, info.num_samples);
+      uint32_t count = std::min(range.count, info.num_samples - start);
+      WavWriter writer;
+      bool rangeOk = writer.open(range.path, info.sample_rate, info.num_channels, info.bits_per_sample, hints);
+      std::vector<char> buffer;
+      for (uint32_t pos = 0; rangeOk && pos < count;)
+      {
+        uint32_t frames = std::min(chunkFrames, count - pos);
+        buffer.resize(static_cast<size_t>(frames) * info.block_align);
+        uint64_t offset = info.data_offset + static_cast<uint64_t>(start + pos) * info.block_align;
+        uint32_t nextFrames = std::min(chunkFrames, count - pos - frames);
+        if (nextFrames > 0 && hints.pattern == AccessPattern::Sequential)
+          file.prefetch(offset + buffer.size(), static_cast<uint64_t>(nextFrames) * info.block_align);
+        rangeOk = file.readAt(offset, buffer.data(), buffer.size()) && writer.write(buffer.data(), frames);
+        if (hints.drop_behind)
+          file.release(offset, buffer.size());
+        pos += frames;
+      }
+      rangeOk = writer.close() && rangeOk;
+      if (!rangeOk)
+      {
+        std::lock_guard<std::mutex> lock(logMutex);
+        std::cerr << "Failed to write split range to: " << range.path << std::endl;
+        ok = false;
+      }
+    };
+    detail::parallelFor(ranges.size(), threads, writeRange);
+    return ok;
+  }
+
+  //------------------------------------------------------------------------------
+  // concatenateFiles: Joins files of one format without decoding them.
+  //------------------------------------------------------------------------------
+  namespace detail
+  {
+#ifdef WAVLIB_POSIX
+    // Appends length bytes at offset of inFd to outFd's current position,
+    // kernel-side where possible: copy_file_range() (which can share extents
+    // on reflink file systems), then sendfile(), then read()/write().
+    inline bool appendRange(int inFd, uint64_t offset, uint64_t length, int outFd)
+    {
+#if defined(__linux__)
+      bool kernelCopy = true;
+      while (length > 0 && kernelCopy)
+      {
+        off_t in = static_cast<off_t>(offset);
+        size_t chunk = static_cast<size_t>(std::min<uint64_t>(length, 1u << 30));
+        ssize_t n = ::copy_file_range(inFd, &in, outFd, nullptr, chunk, 0);
+        if (n < 0 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP))
+        {
+          in = static_cast<off_t>(offset);
+          n = ::sendfile(outFd, inFd, &in, chunk);
+        }
+        if (n < 0 && (errno == EINVAL || errno == ENOSYS))
+          kernelCopy = false;
+        else if (n <= 0)
+          return false;
+        else
+        {
+          offset += static_cast<uint64_t>(n);
+          length -= static_cast<uint64_t>(n);
+        }
+      }
+#endif
+      std::vector<char> buffer(static_cast<size_t>(std::min<uint64_t>(length, 1 << 20)));
+      while (length > 0)
+      {
+        size_t chunk = static_cast<size_t>(std::min<uint64_t>(length, buffer.size()));
+        ssize_t n = ::pread(inFd, buffer.data(), chunk, static_cast<off_t>(offset));
+        if (n <= 0)
+          return false;
+        for (ssize_t done = 0; done < n;)
+        {
+          ssize_t w = ::write(outFd, buffer.data() + done, static_cast<size_t>(n - done));
+          if (w <= 0)
+            return false;
+          done += w;
+        }
+        offset += static_cast<uint64_t>(n);
+        length -= static_cast<uint64_t>(n);
+      }
+      return true;
+    }
+#endif
+  } // namespace detail
+
+  // Writes the samples of every input, in order, to one output file. Inputs
+  // must share sample rate, channel count and bit depth; this is checked from
+  // their headers before anything is written. Only the data chunks are
+  // copied, without passing through user space where the OS allows, so inputs
+  // whose block_align carries padding are rejected. Data sizes that overrun a
+  // file (e.g. 0xFFFFFFFF from a streaming writer) are clamped to the whole
+  // frames actually present. A partial output is removed on failure.
+  inline bool concatenateFiles(const std::vector<std::string> &inPaths, const std::string &outPath)
+  {
+    if (inPaths.empty())
+    {
+      std::cerr << "No input files to concatenate." << std::endl;
+      return false;
+    }
+    std::vector<WavInfo> infos(inPaths.size());
+    uint64_t total = 0;
+    for (size_t i = 0; i < inPaths.size(); i++)
+    {
+      WavInfo &info = infos[i];
+      detail::FileIdentity id;
+      if (!probe(inPaths[i], info) || !detail::fileIdentity(inPaths[i], id))
+        return false;
+      if (info.sample_rate != infos[0].sample_rate || info.num_channels != infos[0].num_channels ||
+          info.bits_per_sample != infos[0].bits_per_sample || info.block_align != infos[0].block_align)
+      {
+        std::cerr << "Format mismatch: " << inPaths[i] << " differs from " << inPaths[0] << std::endl;
+        return false;
+      }
+      if (info.block_align != info.num_channels * (info.bits_per_sample / 8))
+      {
+        std::cerr << "Can't concatenate padded frames (block align " << info.block_align << "): "
+                  << inPaths[i] << std::endl;
+        return false;
+      }
+      uint64_t available = id.size > info.data_offset ? id.size - info.data_offset : 0;
+      if (info.data_size > available)
+        info.data_size = static_cast<uint32_t>(available / info.block_align * info.block_align);
+      total += info.data_size;
+    }
+    if (total + 36 > std::numeric_limits<uint32_t>::max())
+    {
+      std::cerr << "Concatenated data is too large for a WAV file." << std::endl;
+      return false;
+    }
+    WavFile header;
+    header.setInfo(infos[0]);
+    header.data_size = static_cast<uint32_t>(total);
+    header.chunk_size = 36 + header.data_size;
+    std::array<char, 44> h = header.header();
+#ifdef WAVLIB_POSIX
+    int out = ::open(outPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out < 0)
+    {
+      std::cerr << "Error opening output file: " << outPath << std::endl;
+      return false;
+    }
+    bool ok = ::write(out, h.data(), h.size()) == static_cast<ssize_t>(h.size());
+    for (size_t i = 0; ok && i < inPaths.size(); i++)
+    {
+      int in = ::open(inPaths[i].c_str(), O_RDONLY);
+      ok = in >= 0 && detail::appendRange(in, infos[i].data_offset, infos[i].data_size, out);
+      if (in >= 0)
+        ::close(in);
+    }
+    ok = ::close(out) == 0 && ok;
+#else
+    std::ofstream out(outPath, std::ios::binary);
+    if (!out.is_open())
+    {
+      std::cerr << "Error opening output file: " << outPath << std::endl;
+      return false;
+    }
+    out.write(h.data(), h.size());
+    std::vector<char> buffer(1 << 20);
+    bool ok = static_cast<bool>(out);
+    for (size_t i = 0; ok && i < inPaths.size(); i++)
+    {
+      std::ifstream in(inPaths[i], std::ios::binary);
+      in.seekg(static_cast<std::streamoff>(infos[i].data_offset));
+      for (uint64_t left = infos[i].data_size; ok && left > 0;)
+      {
+        size_t chunk = static_cast<size_t>(std::min<uint64_t>(left, buffer.size()));
+        in.read(buffer.data(), static_cast<std::streamsize>(chunk));
+        out.write(buffer.data(), static_cast<std::streamsize>(chunk));
+        ok = in && out;
+        left -= chunk;
+      }
+    }
+    out.close();
+    ok = ok && static_cast<bool>(out);
+#endif
+    if (!ok)
+    {
+      std::cerr << "Error writing output file: " << outPath << std::endl;
+      std::error_code ec;
+      std::filesystem::remove(outPath, ec);
+    }
+    return ok;
+  }
+
+  //------------------------------------------------------------------------------
+  // FftPlan: Radix-2 FFT with precomputed twiddles, for spectral analysis.
+  //------------------------------------------------------------------------------
+  class FftPlan
+  {
+  public:
+    // size must be a power of two (at least 2).
+    explicit FftPlan(uint32_t size = 2) : size_(size)
+    {
+      half_ = size / 2;
+      twiddles_.resize(half_);
+      for (uint32_t k = 0; k < half_; k++)
+        twiddles_[k] = std::polar(1.0f, static_cast<float>(-2.0 * detail::kPi * k / size));
+      bitReverse_.resize(size);
+      uint32_t bits = 0;
+      while ((1u << bits) < size)
+        bits++;
+      for (uint32_t i = 0; i < size; i++)
+      {
+        uint32_t r = 0;
+        for (uint32_t b = 0; b < bits; b++)
+          r |= ((i >> b) & 1u) << (bits - 1 - b);
+        bitReverse_[i] = r;
+      }
+      if (half_ >= 2)
+        halfPlan_.reset(new FftPlan(half_));
+    }
+
+    FftPlan(const FftPlan &other) : FftPlan(other.size_) {}
+    FftPlan &operator=(const FftPlan &other)
+    {
+      if (this != &other)
+        *this = FftPlan(other.size_);
+      return *this;
+    }
+    FftPlan(FftPlan &&) = default;
+    FftPlan &operator=(FftPlan &&) = default;
+
+    uint32_t size() const { return size_; }
+
+    // Smallest power of two >= n.
+    static uint32_t nextPowerOfTwo(uint32_t n)
+    {
+      uint32_t size = 2;
+      while (size < n)
+        size <<= 1;
+      return size;
+    }
+
+    // In-place complex transform of size() points. The inverse is unscaled.
+    void transform(std::complex<float> *data, bool inverse = false) const
+    {
+      for (uint32_t i = 0; i < size_; i++)
+        if (i < bitReverse_[i])
+          std::swap(data[i], data[bitReverse_[i]]);
+      for (uint32_t len = 2; len <= size_; len <<= 1)
+      {
+        uint32_t step = size_ / len;
+        uint32_t halfLen = len / 2;
+        for (uint32_t i = 0; i < size_; i += len)
+        {
+          for (uint32_t k = 0; k < halfLen; k++)
+          {
+            std::complex<float> w = twiddles_[k * step];
+            if (inverse)
+              w = std::conj(w);
+            std::complex<float> a = data[i + k];
+            std::complex<float> b = data[i + k + halfLen] * w;
+            data[i + k] = a + b;
+            data[i + k + halfLen] = a - b;
+          }
+        }
+      }
+    }
+
+    // Spectrum of size() real samples: writes size()/2 + 1 bins to out, using
+    // one half-size complex transform.
+    void realForward(const float *in, std::complex<float> *out) const
+    {
+      if (!halfPlan_)
+      {
+        out[0] = in[0] + in[1];
+        out[1] = in[0] - in[1];
+        return;
+      }
+      scratch_.resize(half_);
+      for (uint32_t n = 0; n < half_; n++)
+        scratch_[n] = std::complex<float>(in[2 * n], in[2 * n + 1]);
+      halfPlan_->transform(scratch_.data());
+      for (uint32_t k = 0; k <= half_; k++)
+      {
+        std::complex<float> zk = scratch_[k == half_ ? 0 : k];
+        std::complex<float> zc = std::conj(scratch_[k == 0 ? 0 : half_ - k]);
+        std::complex<float> even = 0.5f * (zk + zc);
+        std::complex<float> odd = std::complex<float>(0.0f, -0.5f) * (zk - zc);
+        std::complex<float> w = k == half_ ? std::complex<float>(-1.0f, 0.0f) : twiddles_[k];
+        out[k] = even + w * odd;
+      }
+    }
+
+    // |X[k]|^2 for the size()/2 + 1 bins of a real signal.
+    void powerSpectrum(const float *in, float *power) const
+    {
+      spectrum_.resize(half_ + 1);
+      realForward(in, spectrum_.data());
+      for (uint32_t k = 0; k <= half_; k++)
+        power[k] = std::norm(spectrum_[k]);
+    }
+
+  private:
+    uint32_t size_;
+    uint32_t half_;
+    std::vector<std::complex<float>> twiddles_;
+    std::vector<uint32_t> bitReverse_;
+    std::unique_ptr<FftPlan> halfPlan_;
+    // Per-plan scratch: use one plan per thread.
+    mutable std::vector<std::complex<float>> scratch_;
+    mutable std::vector<std::complex<float>> spectrum_;
+  };
+
+  //------------------------------------------------------------------------------
+  // VoiceActivityDetector<T>: Streaming energy / spectral-flux speech detection.
+  //------------------------------------------------------------------------------
+  struct VadSegment
+  {
+    uint64_t start = 0; // first frame of speech
+    uint64_t end = 0;   // one past the last frame of speech
+  };
+
+  struct VadOptions
+  {
+    double frameMs = 20.0;         // analysis frame length
+    double energyMarginDb = 12.0;  // speech if this far above the noise floor...
+    double minEnergyDb = -55.0;    // ...and at least this loud (dBFS)
+    double fluxThreshold = 0.25;   // normalized spectral flux marking onsets
+    double noiseRiseDbPerSec = 3.0; // how fast the noise floor may rise
+    double speechNoiseRiseDbPerSec = 0.0; // ...and while in speech (0 freezes it)
+    double hangoverMs = 200.0;     // keep speech on this long after the last speech frame
+    double minSpeechMs = 100.0;    // drop segments shorter than this
+  };
+
+  // Classifies fixed frames as speech or not from their level relative to an
+  // adaptive noise floor, with spectral flux (of the Hann-windowed frame)
+  // catching soft onsets, and emits smoothed segments as they close. The frame
+  // is the mean of the channels. The floor only tracks upward outside speech,
+  // so long steady speech isn't absorbed into it.
+  template <typename T>
+  class VoiceActivityDetector
+  {
+  public:
+    explicit VoiceActivityDetector(uint32_t sample_rate, const VadOptions &options = VadOptions())
+        : options_(options)
+    {
+      frameLength_ = std::max<uint32_t>(16, static_cast<uint32_t>(sample_rate * options.frameMs / 1000.0));
+      fft_ = FftPlan(FftPlan::nextPowerOfTwo(frameLength_));
+      frame_.assign(fft_.size(), 0.0f);
+      windowed_.assign(fft_.size(), 0.0f);
+      window_.resize(frameLength_);
+      for (uint32_t n = 0; n < frameLength_; n++)
+        window_[n] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * detail::kPi * n / frameLength_));
+      power_.assign(fft_.size() / 2 + 1, 0.0f);
+      magnitude_.assign(power_.size(), 0.0f);
+      previous_.assign(power_.size(), 0.0f);
+      double framesPerSec = 1000.0 / options.frameMs;
+      noiseRise_ = options.noiseRiseDbPerSec / framesPerSec;
+      speechNoiseRise_ = options.speechNoiseRiseDbPerSec / framesPerSec;
+      hangoverFrames_ = static_cast<uint32_t>(options.hangoverMs / options.frameMs);
+      minSpeechFrames_ = static_cast<uint32_t>(options.minSpeechMs / options.frameMs);
+      noiseDb_ = options.minEnergyDb;
+    }
+
+    // Consumes a block and appends every speech segment that has closed.
+    void process(const WavView<T> &block, std::vector<VadSegment> &segments)
+    {
+      for (uint32_t i = 0; i < block.num_samples; i++)
+      {
+        float value = detail::sampleToFloat(block.sample(0, i));
+        if (block.num_channels == 2)
+          value = 0.5f * (value + detail::sampleToFloat(block.sample(1, i)));
+        frame_[fill_++] = value;
+        if (fill_ == frameLength_)
+        {
+          classify(segments);
+          fill_ = 0;
+        }
+      }
+    }
+
+    // Closes any open segment at the end of the input.
+    void flush(std::vector<VadSegment> &segments)
+    {
+      if (inSpeech_)
+        close(segments, frameIndex_ * frameLength_ + fill_);
+      inSpeech_ = false;
+    }
+
+  private:
+    void classify(std::vector<VadSegment> &segments)
+    {
+      // Frame energy in dBFS.
+      double sum = 0.0;
+      for (uint32_t n = 0; n < frameLength_; n++)
+        sum += frame_[n] * frame_[n];
+      double energyDb = 10.0 * std::log10(sum / frameLength_ + 1e-12) + 3.0103; // full-scale sine = 0 dB
+
+      // Positive spectral flux, normalized by the frame's total magnitude.
+      for (uint32_t n = 0; n < frameLength_; n++)
+        windowed_[n] = frame_[n] * window_[n];
+      fft_.powerSpectrum(windowed_.data(), power_.data());
+      double flux = 0.0, total = 0.0;
+      for (size_t k = 0; k < power_.size(); k++)
+      {
+        magnitude_[k] = std::sqrt(power_[k]);
+        float rise = magnitude_[k] - previous_[k];
+        flux += rise > 0.0f ? rise : 0.0f;
+        total += magnitude_[k];
+      }
+      flux = total > 0.0 ? flux / total : 0.0;
+      previous_.swap(magnitude_);
+
+      if (energyDb < noiseDb_)
+        noiseDb_ = energyDb;
+      else
+        noiseDb_ = std::min(energyDb, noiseDb_ + (inSpeech_ ? speechNoiseRise_ : noiseRise_));
+
+      bool loud = energyDb > options_.minEnergyDb;
+      bool speech = loud && (energyDb > noiseDb_ + options_.energyMarginDb ||
+                             (flux > options_.fluxThreshold && energyDb > noiseDb_ + options_.energyMarginDb / 2));
+      uint64_t frameStart = frameIndex_ * frameLength_;
+      if (speech)
+      {
+        if (!inSpeech_)
+        {
+          inSpeech_ = true;
+          speechStart_ = frameStart;
+        }
+        lastSpeechEnd_ = frameStart + frameLength_;
+        silentFrames_ = 0;
+      }
+      else if (inSpeech_ && ++silentFrames_ > hangoverFrames_)
+      {
+        close(segments, frameStart);
+        inSpeech_ = false;
+      }
+      frameIndex_++;
+    }
+
+    void close(std::vector<VadSegment> &segments, uint64_t end)
+    {
+      // The hangover extends the segment, but never past where input stopped.
+      uint64_t hangoverEnd = lastSpeechEnd_ + static_cast<uint64_t>(hangoverFrames_) * frameLength_;
+      end = std::min(end, hangoverEnd);
+      if (end - speechStart_ >= static_cast<uint64_t>(minSpeechFrames_) * frameLength_)
+        segments.push_back({speechStart_, end});
+    }
+
+    VadOptions options_;
+    uint32_t frameLength_ = 0;
+    FftPlan fft_;
+    std::vector<float> frame_;
+    std::vector<float> windowed_;
+    std::vector<float> window_;
+    std::vector<float> power_;
+    std::vector<float> magnitude_;
+    std::vector<float> previous_;
+    uint32_t fill_ = 0;
+    uint64_t frameIndex_ = 0;
+    double noiseDb_ = 0.0;
+    double noiseRise_ = 0.0;
+    double speechNoiseRise_ = 0.0;
+    uint32_t hangoverFrames_ = 0;
+    uint32_t minSpeechFrames_ = 0;
+    bool inSpeech_ = false;
+    uint64_t speechStart_ = 0;
+    uint64_t lastSpeechEnd_ = 0;
+    uint32_t silentFrames_ = 0;
+  };
+
+  // Runs voice activity detection over a whole clip.
+  template <typename T>
+  std::vector<VadSegment> detectSpeech(const WavView<T> &input, const VadOptions &options = VadOptions())
+  {
+    VoiceActivityDetector<T> vad(input.sample_rate, options);
+    std::vector<VadSegment> segments;
+    vad.process(input, segments);
+    vad.flush(segments);
+    return segments;
+  }
+
+  template <typename T>
+  std::vector<VadSegment> detectSpeech(const WavData<T> &input, const VadOptions &options = VadOptions())
+  {
+    return detectSpeech(input.view(), options);
+  }
+
+  //------------------------------------------------------------------------------
+  // FeatureExtractor: Log-mel and MFCC features for ML pipelines.
+  //------------------------------------------------------------------------------
+  struct FeatureOptions
+  {
+    double frameMs = 25.0;      // analysis window length
+    double hopMs = 10.0;        // frame step
+    double preemphasis = 0.97;  // y[n] = x[n] - a * x[n - 1]; 0 disables
+    uint32_t num_mels = 80;
+    uint32_t num_mfcc = 0;      // 0 = log-mel output, otherwise this many cepstra
+    double min_freq = 20.0;
+    double max_freq = 0.0;      // 0 = Nyquist
+    float log_floor = 1e-10f;
+  };
+
+  // Frames the mean of the channels with a Hann window, takes the power
+  // spectrum, applies a triangular (HTK) mel filterbank and a log, and
+  // optionally an orthonormal DCT-II. Output is row-major [frames x dims]
+  // float32. An extractor holds scratch buffers: use one per thread.
+  class FeatureExtractor
+  {
+  public:
+    FeatureExtractor(uint32_t sample_rate, const FeatureOptions &options = FeatureOptions())
+        : options_(options)
+    {
+      frameLength_ = std::max<uint32_t>(2, static_cast<uint32_t>(sample_rate * options.frameMs / 1000.0));
+      hop_ = std::max<uint32_t>(1, static_cast<uint32_t>(sample_rate * options.hopMs / 1000.0));
+      fft_ = FftPlan(FftPlan::nextPowerOfTwo(frameLength_));
+      window_.resize(frameLength_);
+      for (uint32_t n = 0; n < frameLength_; n++)
+        window_[n] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * detail::kPi * n / frameLength_));
+      buildFilterbank(sample_rate);
+      if (options.num_mfcc > 0)
+      {
+        dct_.resize(static_cast<size_t>(options.num_mfcc) * options.num_mels);
+        for (uint32_t k = 0; k < options.num_mfcc; k++)
+        {
+          double scale = std::sqrt((k == 0 ? 1.0 : 2.0) / options.num_mels);
+          for (uint32_t m = 0; m < options.num_mels; m++)
+            dct_[static_cast<size_t>(k) * options.num_mels + m] =
+                static_cast<float>(scale * std::cos(detail::kPi * k * (m + 0.5) / options.num_mels));
+        }
+      }
+      frame_.assign(fft_.size(), 0.0f);
+      power_.assign(fft_.size() / 2 + 1, 0.0f);
+      mel_.assign(options.num_mels, 0.0f);
+    }
+
+    // Values per frame: num_mfcc if set, else num_mels.
+    uint32_t dims() const { return options_.num_mfcc > 0 ? options_.num_mfcc : options_.num_mels; }
+
+    // Frames produced for a clip of num_samples samples (at least one; the
+    // last frame is zero-padded).
+    uint32_t numFrames(uint32_t num_samples) const
+    {
+      return num_samples <= frameLength_ ? 1 : 1 + (num_samples - frameLength_ + hop_ - 1) / hop_;
+    }
+
+    // Writes numFrames(input.num_samples) x dims() floats to out.
+    template <typename T>
+    void compute(const WavView<T> &input, float *out)
+    {
+      // Mono, normalized, pre-emphasized signal.
+      signal_.resize(input.num_samples);
+      for (uint32_t i = 0; i < input.num_samples; i++)
+      {
+        float value = detail::sampleToFloat(input.sample(0, i));
+        if (input.num_channels == 2)
+          value = 0.5f * (value + detail::sampleToFloat(input.sample(1, i)));
+        signal_[i] = value;
+      }
+      const float a = static_cast<float>(options_.preemphasis);
+      if (a != 0.0f)
+        for (uint32_t i = input.num_samples; i-- > 1;)
+          signal_[i] -= a * signal_[i - 1];
+
+      const uint32_t frames = numFrames(input.num_samples);
+      const uint32_t d = dims();
+      for (uint32_t f = 0; f < frames; f++)
+      {
+        size_t start = static_cast<size_t>(f) * hop_;
+        size_t available = start < signal_.size() ? std::min<size_t>(frameLength_, signal_.size() - start) : 0;
+        for (size_t n = 0; n < available; n++)
+          frame_[n] = signal_[start + n] * window_[n];
+        std::fill(frame_.begin() + available, frame_.end(), 0.0f);
+        fft_.powerSpectrum(frame_.data(), power_.data());
+        for (uint32_t m = 0; m < options_.num_mels; m++)
+        {
+          const Filter &filter = filters_[m];
+          float energy = 0.0f;
+          for (size_t k = 0; k < filter.weights.size(); k++)
+            energy += filter.weights[k] * power_[filter.first + k];
+          mel_[m] = std::log(std::max(energy, options_.log_floor));
+        }
+        float *row = out + static_cast<size_t>(f) * d;
+        if (options_.num_mfcc == 0)
+        {
+          std::copy(mel_.begin(), mel_.end(), row);
+          continue;
+        }
+        for (uint32_t k = 0; k < options_.num_mfcc; k++)
+          row[k] = detail::dotProduct(&dct_[static_cast<size_t>(k) * options_.num_mels], mel_.data(), options_.num_mels);
+      }
+    }
+
+    template <typename T>
+    std::vector<float> compute(const WavView<T> &input)
+    {
+      std::vector<float> out(static_cast<size_t>(numFrames(input.num_samples)) * dims());
+      compute(input, out.data());
+      return out;
+    }
+
+  private:
+    struct Filter
+    {
+      uint32_t first = 0; // first FFT bin with a non-zero weight
+      std::vector<float> weights;
+    };
+
+    static double hzToMel(double hz) { return 2595.0 * std::log10(1.0 + hz / 700.0); }
+    static double melToHz(double mel) { return 700.0 * (std::pow(10.0, mel / 2595.0) - 1.0); }
+
+    void buildFilterbank(uint32_t sample_rate)
+    {
+      const uint32_t bins = fft_.size() / 2 + 1;
+      double maxFreq = options_.max_freq > 0.0 ? options_.max_freq : sample_rate / 2.0;
+      double lo = hzToMel(options_.min_freq), hi = hzToMel(maxFreq);
+      std::vector<double> edges(options_.num_mels + 2);
+      for (size_t i = 0; i < edges.size(); i++)
+        edges[i] = melToHz(lo + (hi - lo) * i / (options_.num_mels + 1));
+      filters_.resize(options_.num_mels);
+      for (uint32_t m = 0; m < options_.num_mels; m++)
+      {
+        Filter &filter = filters_[m];
+        bool started = false;
+        for (uint32_t k = 0; k < bins; k++)
+        {
+          double hz = static_cast<double>(k) * sample_rate / fft_.size();
+          double w = 0.0;
+          if (hz > edges[m] && hz <= edges[m + 1])
+            w = (hz - edges[m]) / (edges[m + 1] - edges[m]);
+          else if (hz > edges[m + 1] && hz < edges[m + 2])
+            w = (edges[m + 2] - hz) / (edges[m + 2] - edges[m + 1]);
+          if (w <= 0.0 && !started)
+            continue;
+          if (w <= 0.0)
+            break;
+          if (!started)
+            filter.first = k;
+          started = true;
+          filter.weights.push_back(static_cast<float>(w));
+        }
+      }
+    }
+
+    FeatureOptions options_;
+    uint32_t frameLength_ = 0;
+    uint32_t hop_ = 0;
+    FftPlan fft_;
+    std::vector<float> window_;
+    std::vector<Filter> filters_;
+    std::vector<float> dct_;
+    std::vector<float> signal_;
+    std::vector<float> frame_;
+    std::vector<float> power_;
+    std::vector<float> mel_;
+  };
+
+  // A batch of features in one contiguous row-major float32 tensor of shape
+  // [batch x frames x dims], zero-padded to the longest clip.
+  struct FeatureBatch
+  {
+    uint32_t batch = 0;
+    uint32_t frames = 0;
+    uint32_t dims = 0;
+    std::vector<uint32_t> num_frames; // valid frames per clip
+    std::vector<float> data;
+  };
+
+  // Extracts features for many clips (all at sample_rate) on `threads` workers.
+  template <typename T>
+  FeatureBatch extractFeatures(const std::vector<WavView<T>> &clips, uint32_t sample_rate,
+                               const FeatureOptions &options = FeatureOptions(), unsigned threads = 0)
+  {
+    FeatureBatch result;
+    FeatureExtractor prototype(sample_rate, options);
+    result.batch = static_cast<uint32_t>(clips.size());
+    result.dims = prototype.dims();
+    for (const WavView<T> &clip : clips)
+    {
+      result.num_frames.push_back(prototype.numFrames(clip.num_samples));
+      result.frames = std::max(result.frames, result.num_frames.back());
+    }
+    const size_t clipStride = static_cast<size_t>(result.frames) * result.dims;
+    result.data.assign(clipStride * clips.size(), 0.0f);
+    if (threads == 0)
+      threads = std::max(1u, std::thread::hardware_concurrency());
+    // One extractor per worker; worker g takes clips g, g + groups, ...
+    size_t groups = std::min<size_t>(threads, clips.size());
+    auto runGroup = [&](size_t g)
+    {
+      FeatureExtractor extractor = prototype;
+      for (size_t c = g; c < clips.size(); c += groups)
+        extractor.compute(clips[c], result.data.data() + c * clipStride);
+    };
+    detail::parallelFor(groups, static_cast<unsigned>(groups), runGroup);
+    return result;
+  }
+
+  template <typename T>
+  FeatureBatch extractFeatures(const std::vector<WavData<T>> &clips, const FeatureOptions &options = FeatureOptions(),
+                               unsigned threads = 0)
+  {
+    std::vector<WavView<T>> views;
+    for (const WavData<T> &clip : clips)
+      views.push_back(clip.view());
+    return extractFeatures(views, clips.empty() ? 0 : clips.front().sample_rate, options, threads);
+  }
+
+  //------------------------------------------------------------------------------
+  // Clip bundles: Many clips packed into one file behind a sorted index.
+  //------------------------------------------------------------------------------
+  /*
+    Bundle layout (little-endian):
+    ----------------------------------------------------------------------------
+    Offset  Size  Description
+    ----------------------------------------------------------------------------
+    0       4     "WLBD"
+    4       4     Version (1)
+    8       8     Clip count
+    16      8     Offset of the index
+    24      8     Offset of the name table
+    32      *     Clip data, each clip starting on a 64-byte boundary
+    *       *     Name table (concatenated clip names, not terminated)
+    *       48*N  Index entries (BundleEntry), sorted by name, starting on an
+                  8-byte boundary
+  */
+  struct BundleEntry
+  {
+    enum Layout : uint16_t
+    {
+      kInterleavedPcm = 0, // raw_data bytes exactly as in the WAV file
+      kPlanarFloat = 1,    // float32 in [-1, 1), one channel after another
+      kPlanarPcm = 2       // native PCM samples, one channel after another
+    };
+
+    uint64_t data_offset = 0;
+    uint64_t data_size = 0;
+    uint64_t name_offset = 0; // relative to the name table
+    uint32_t name_size = 0;
+    uint32_t sample_rate = 0;
+    uint32_t num_samples = 0; // per channel
+    uint16_t num_channels = 0;
+    uint16_t bits_per_sample = 0;
+    uint16_t layout = kInterleavedPcm;
+    uint16_t reserved0 = 0;
+    uint32_t reserved1 = 0;
+  };
+  static_assert(sizeof(BundleEntry) == 48, "BundleEntry must match the on-disk index entry");
+
+  // Builds a bundle: clip data is streamed to disk as clips are added; the
+  // sorted index is written by finish().
+  class BundleWriter
+  {
+  public:
+    BundleWriter() = default;
+    BundleWriter(const BundleWriter &) = delete;
+    BundleWriter &operator=(const BundleWriter &) = delete;
+    ~BundleWriter() { finish(); }
+
+    bool open(const std::string &filePath)
+    {
+      out_.open(filePath, std::ios::binary | std::ios::trunc);
+      if (!out_.is_open())
+      {
+        std::cerr << "Error opening output file: " << filePath << std::endl;
+        return false;
+      }
+      entries_.clear();
+      names_.clear();
+      char header[32] = {0};
+      out_.write(header, sizeof(header));
+      offset_ = sizeof(header);
+      return static_cast<bool>(out_);
+    }
+
+    // Adds a clip as its raw interleaved PCM bytes. Entries don't record
+    // block_align, so files whose frames carry padding are rejected.
+    bool add(const std::string &name, const WavFile &file)
+    {
+      if (file.block_align != file.num_channels * (file.bits_per_sample / 8))
+      {
+        std::cerr << "Can't bundle padded frames (block align " << file.block_align << "): " << name << std::endl;
+        return false;
+      }
+      BundleEntry entry = makeEntry(name, file.sample_rate, file.num_samples, file.num_channels,
+                                    file.bits_per_sample, BundleEntry::kInterleavedPcm);
+      return append(entry, file.raw_data.data(), file.data_size);
+    }
+
+    // Adds a clip converted to planar float32, ready for numeric consumers.
+    template <typename T>
+    bool addPlanarFloat(const std::string &name, const WavView<T> &clip)
+    {
+      uint16_t channels = clip.num_channels == 2 ? 2 : 1;
+      BundleEntry entry = makeEntry(name, clip.sample_rate, clip.num_samples, channels, 32,
+                                    BundleEntry::kPlanarFloat);
+      std::vector<float> planar(static_cast<size_t>(clip.num_samples) * channels);
+      for (uint16_t c = 0; c < channels; c++)
+        for (uint32_t i = 0; i < clip.num_samples; i++)
+          planar[static_cast<size_t>(c) * clip.num_samples + i] = detail::sampleToFloat(clip.sample(c, i));
+      return append(entry, reinterpret_cast<const char *>(planar.data()), planar.size() * sizeof(float));
+    }
+
+    // Adds a clip as planar samples of its own type (no conversion).
+    template <typename T>
+    bool addPlanar(const std::string &name, const WavView<T> &clip)
+    {
+      if (clip.stride != 1)
+        return addPlanar(name, WavData<T>(clip).view());
+      uint16_t channels = clip.num_channels == 2 ? 2 : 1;
+      BundleEntry entry = makeEntry(name, clip.sample_rate, clip.num_samples, channels, sizeof(T) * 8,
+                                    BundleEntry::kPlanarPcm);
+      const size_t bytes = static_cast<size_t>(clip.num_samples) * sizeof(T);
+      bool ok = append(entry, reinterpret_cast<const char *>(clip.channel1), bytes);
+      if (channels == 2)
+      {
+        out_.write(reinterpret_cast<const char *>(clip.channel2), static_cast<std::streamsize>(bytes));
+        offset_ += bytes;
+        entries_.back().data_size += bytes;
+      }
+      return ok && static_cast<bool>(out_);
+    }
+
+    // Writes the name table and the sorted index, then closes the file.
+    bool finish()
+    {
+      if (!out_.is_open())
+        return true;
+      uint64_t namesOffset = offset_;
+      out_.write(names_.data(), static_cast<std::streamsize>(names_.size()));
+      // Keep the index entries' 64-bit fields naturally aligned.
+      static const char padding[8] = {0};
+      uint64_t indexOffset = (namesOffset + names_.size() + 7) & ~static_cast<uint64_t>(7);
+      out_.write(padding, static_cast<std::streamsize>(indexOffset - namesOffset - names_.size()));
+      std::sort(entries_.begin(), entries_.end(), [&](const BundleEntry &a, const BundleEntry &b)
+                { return names_.compare(a.name_offset, a.name_size, names_, b.name_offset, b.name_size) < 0; });
+      out_.write(reinterpret_cast<const char *>(entries_.data()),
+                 static_cast<std::streamsize>(entries_.size() * sizeof(BundleEntry)));
+      uint32_t version = 1;
+      uint64_t count = entries_.size();
+      out_.seekp(0);
+      out_.write("WLBD", 4);
+      out_.write(reinterpret_cast<const char *>(&version), sizeof(version));
+      out_.write(reinterpret_cast<const char *>(&count), sizeof(count));
+      out_.write(reinterpret_cast<const char *>(&indexOffset), sizeof(indexOffset));
+      out_.write(reinterpret_cast<const char *>(&namesOffset), sizeof(namesOffset));
+      bool ok = static_cast<bool>(out_);
+      out_.close();
+      return ok;
+    }
+
+  private:
+    BundleEntry makeEntry(const std::string &name, uint32_t sample_rate, uint32_t num_samples,
+                          uint16_t num_channels, uint16_t bits_per_sample, uint16_t layout)
+    {
+      BundleEntry entry;
+      entry.name_offset = names_.size();
+      entry.name_size = static_cast<uint32_t>(name.size());
+      entry.sample_rate = sample_rate;
+      entry.num_samples = num_samples;
+      entry.num_channels = num_channels;
+      entry.bits_per_sample = bits_per_sample;
+      entry.layout = layout;
+      names_ += name;
+      return entry;
+    }
+
+    bool append(BundleEntry &entry, const char *data, uint64_t size)
+    {
+      // Align every clip to 64 bytes so mapped samples are suitably aligned.
+      static const char padding[64] = {0};
+      uint64_t aligned = (offset_ + 63) & ~static_cast<uint64_t>(63);
+      out_.write(padding, static_cast<std::streamsize>(aligned - offset_));
+      entry.data_offset = aligned;
+      entry.data_size = size;
+      out_.write(data, static_cast<std::streamsize>(size));
+      offset_ = aligned + size;
+      entries_.push_back(entry);
+      return static_cast<bool>(out_);
+    }
+
+    std::ofstream out_;
+    uint64_t offset_ = 0;
+    std::vector<BundleEntry> entries_;
+    std::string names_;
+  };
+
+  // Memory-maps a bundle. After open(), lookups and clip access touch only the
+  // mapping, with no further system calls. Pass AccessPattern::Random when
+  // clips are picked at random, so faults don't read ahead into other clips.
+  class BundleReader
+  {
+  public:
+    bool open(const std::string &filePath, AccessPattern pattern = AccessPattern::Normal)
+    {
+      if (!map_.open(filePath, pattern))
+        return false;
+      const char *base = map_.data();
+      uint64_t count = 0, indexOffset = 0, namesOffset = 0;
+      if (map_.size() < 32 || std::strncmp(base, "WLBD", 4) != 0)
+      {
+        std::cerr << "Not a clip bundle: " << filePath << std::endl;
+        map_.close();
+        return false;
+      }
+      std::memcpy(&count, base + 8, sizeof(count));
+      std::memcpy(&indexOffset, base + 16, sizeof(indexOffset));
+      std::memcpy(&namesOffset, base + 24, sizeof(namesOffset));
+      const uint64_t fileSize = map_.size();
+      bool ok = namesOffset <= indexOffset && indexOffset <= fileSize &&
+                count <= (fileSize - indexOffset) / sizeof(BundleEntry);
+      // Entries are copied out, so an index that isn't 8-byte aligned (as in
+      // bundles written before it was padded) is still read safely.
+      if (ok)
+      {
+        entries_.resize(static_cast<size_t>(count));
+        if (count > 0)
+          std::memcpy(entries_.data(), base + indexOffset, entries_.size() * sizeof(BundleEntry));
+      }
+      for (size_t i = 0; ok && i < entries_.size(); i++)
+        ok = validEntry(entries_[i], namesOffset, indexOffset);
+      if (!ok)
+      {
+        std::cerr << "Corrupt clip bundle index: " << filePath << std::endl;
+        entries_.clear();
+        map_.close();
+        return false;
+      }
+      names_ = base + namesOffset;
+      count_ = entries_.size();
+      return true;
+    }
+
+    size_t size() const { return count_; }
+    const BundleEntry &entry(size_t i) const { return entries_[i]; }
+
+    std::string name(size_t i) const
+    {
+      return std::string(names_ + entries_[i].name_offset, entries_[i].name_size);
+    }
+
+    // Binary-searches the sorted index; returns size() if the name is absent.
+    size_t find(const std::string &name) const
+    {
+      size_t lo = 0, hi = count_;
+      while (lo < hi)
+      {
+        size_t mid = lo + (hi - lo) / 2;
+        const BundleEntry &e = entries_[mid];
+        int cmp = name.compare(0, std::string::npos, names_ + e.name_offset, e.name_size);
+        if (cmp == 0)
+          return mid;
+        if (cmp < 0)
+          hi = mid;
+        else
+          lo = mid + 1;
+      }
+      return count_;
+    }
+
+    // Zero-copy view of an interleaved PCM clip; T must match its bit depth.
+    template <typename T>
+    WavView<T> view(size_t i) const
+    {
+      const BundleEntry &e = entries_[i];
+      WavView<T> v;
+      v.sample_rate = e.sample_rate;
+      v.num_channels = e.num_channels;
+      v.bits_per_sample = e.bits_per_sample;
+      if (e.layout != BundleEntry::kInterleavedPcm || e.bits_per_sample != sizeof(T) * 8)
+      {
+        std::cerr << "Clip " << i << " is not " << (sizeof(T) * 8) << "-bit interleaved PCM." << std::endl;
+        return v;
+      }
+      v.num_samples = e.num_samples;
+      v.stride = e.num_channels;
+      v.channel1 = reinterpret_cast<const T *>(map_.data() + e.data_offset);
+      if (e.num_channels == 2)
+        v.channel2 = v.channel1 + 1;
+      return v;
+    }
+
+    // Zero-copy view of a planar clip: float for kPlanarFloat clips, or the
+    // matching sample type for kPlanarPcm clips.
+    template <typename T = float>
+    WavView<T> planarView(size_t i) const
+    {
+      const BundleEntry &e = entries_[i];
+      WavView<T> v;
+      v.sample_rate = e.sample_rate;
+      v.num_channels = e.num_channels;
+      v.bits_per_sample = e.bits_per_sample;
+      bool matches = std::is_same<T, float>::value ? e.layout == BundleEntry::kPlanarFloat
+                                                   : e.layout == BundleEntry::kPlanarPcm && e.bits_per_sample == sizeof(T) * 8;
+      if (!matches)
+      {
+        std::cerr << "Clip " << i << " is not planar with this sample type." << std::endl;
+        return v;
+      }
+      v.num_samples = e.num_samples;
+      v.channel1 = reinterpret_cast<const T *>(map_.data() + e.data_offset);
+      if (e.num_channels == 2)
+        v.channel2 = v.channel1 + e.num_samples;
+      return v;
+    }
+
+    // Copies an interleaved PCM clip out into a standalone WavFile.
+    WavFile file(size_t i) const
+    {
+      const BundleEntry &e = entries_[i];
+      WavFile wf;
+      if (e.layout != BundleEntry::kInterleavedPcm)
+      {
+        std::cerr << "Clip " << i << " is not interleaved PCM." << std::endl;
+        return wf;
+      }
+      wf.sample_rate = e.sample_rate;
+      wf.num_channels = e.num_channels;
+      wf.bits_per_sample = e.bits_per_sample;
+      wf.block_align = e.num_channels * (e.bits_per_sample / 8);
+      wf.num_samples = e.num_samples;
+      wf.data_size = static_cast<uint32_t>(e.data_size);
+      wf.chunk_size = 36 + wf.data_size;
+      const char *data = map_.data() + e.data_offset;
+      wf.raw_data.assign(data, data + e.data_size);
+      return wf;
+    }
+
+  private:
+    // Checks that an entry's name and samples lie inside their sections and
+    // that its sample data is aligned for the views handed out.
+    static bool validEntry(const BundleEntry &e, uint64_t namesOffset, uint64_t indexOffset)
+    {
+      if (e.name_offset > indexOffset - namesOffset || e.name_size > indexOffset - namesOffset - e.name_offset)
+        return false;
+      if (e.data_offset > namesOffset || e.data_size > namesOffset - e.data_offset)
+        return false;
+      const uint64_t bytesPerSample = (e.bits_per_sample + 7) / 8;
+      if (e.num_channels == 0 || bytesPerSample == 0 || e.layout > BundleEntry::kPlanarPcm)
+        return false;
+      if ((bytesPerSample & (bytesPerSample - 1)) == 0 && e.data_offset % bytesPerSample != 0)
+        return false;
+      return static_cast<uint64_t>(e.num_samples) * e.num_channels * bytesPerSample <= e.data_size;
+    }
+
+    detail::MappedFile map_;
+    std::vector<BundleEntry> entries_;
+    const char *names_ = nullptr;
+    size_t count_ = 0;
+  };
+
+  //------------------------------------------------------------------------------
+  // CropSampler: Random fixed-length crops from a corpus, read by byte range.
+  //------------------------------------------------------------------------------
+  // Files are probed once (or the probe results loaded from an index file);
+  // each crop then costs one positional read of exactly its frames. A file is
+  // opened the first time a crop needs it and stays open for the sampler's
+  // lifetime, so large corpora may need a raised descriptor limit.
+  class CropSampler
+  {
+  public:
+    struct File
+    {
+      std::string path;
+      WavInfo info;
+      uint64_t size = 0;     // file size and mtime when probed, so a stale
+      int64_t mtime_ns = 0;  // index entry can be detected
+    };
+
+    struct Batch
+    {
+      uint32_t batch = 0;
+      uint16_t channels = 0;
+      uint32_t frames = 0;
+      std::vector<float> data;      // [batch x channels x frames], in [-1, 1)
+      std::vector<uint32_t> files;  // source file of each crop
+      std::vector<uint32_t> starts; // first source frame of each crop
+    };
+
+    // Probes every path on `threads` workers; unreadable files are skipped.
+    bool open(const std::vector<std::string> &paths, unsigned threads = 0)
+    {
+      std::vector<File> probed(paths.size());
+      std::vector<char> valid(paths.size(), 0);
+      auto probeFile = [&](size_t i)
+      {
+        detail::FileIdentity id;
+        probed[i].path = paths[i];
+        valid[i] = probe(paths[i], probed[i].info) && probed[i].info.num_samples > 0 &&
+                   detail::fileIdentity(paths[i], id);
+        probed[i].size = id.size;
+        probed[i].mtime_ns = id.mtime_ns;
+      };
+      detail::parallelFor(paths.size(), threads, probeFile);
+      files_.clear();
+      for (size_t i = 0; i < paths.size(); i++)
+        if (valid[i])
+          files_.push_back(std::move(probed[i]));
+      buildWeights();
+      return !files_.empty();
+    }
+
+    // Saves the probe results so later runs can skip probing.
+    bool saveIndex(const std::string &indexPath) const
+    {
+      std::ofstream out(indexPath);
+      if (!out.is_open())
+      {
+        std::cerr << "Error opening output file: " << indexPath << std::endl;
+        return false;
+      }
+      for (const File &f : files_)
+        out << f.info.data_offset << ' ' << f.info.data_size << ' ' << f.info.block_align << ' '
+            << f.info.sample_rate << ' ' << f.info.num_channels << ' ' << f.info.bits_per_sample << ' '
+            << f.size << ' ' << f.mtime_ns << ' ' << f.path << '\n';
+      return static_cast<bool>(out);
+    }
+
+    // Loads saved probe results. Files whose size or mtime changed since they
+    // were indexed are reported and skipped; probe them again with open().
+    bool loadIndex(const std::string &indexPath)
+    {
+      std::ifstream in(indexPath);
+      if (!in.is_open())
+      {
+        std::cerr << "Couldn't open file: " << indexPath << std::endl;
+        return false;
+      }
+      files_.clear();
+      std::string line;
+      while (std::getline(in, line))
+      {
+        std::istringstream fields(line);
+        File f;
+        fields >> f.info.data_offset >> f.info.data_size >> f.info.block_align >> f.info.sample_rate >>
+            f.info.num_channels >> f.info.bits_per_sample >> f.size >> f.mtime_ns;
+        fields.get(); // separator before the path, which may contain spaces
+        std::getline(fields, f.path);
+        if (!fields && !fields.eof())
+          continue;
+        if (f.path.empty() || f.info.block_align == 0)
+          continue;
+        f.info.num_samples = f.info.data_size / f.info.block_align;
+        if (f.info.num_samples == 0)
+          continue;
+        detail::FileIdentity id;
+        if (!detail::fileIdentity(f.path, id) || id.size != f.size || id.mtime_ns != f.mtime_ns)
+        {
+          std::cerr << "Index entry is out of date: " << f.path << std::endl;
+          continue;
+        }
+        files_.push_back(std::move(f));
+      }
+      buildWeights();
+      return !files_.empty();
+    }
+
+    const std::vector<File> &files() const { return files_; }
+
+    // Picks batch crops of `frames` frames, uniformly over all frames of the
+    // corpus (longer files are picked more often), and reads them on `threads`
+    // workers. channels == 1 averages the file's channels; channels == 2 keeps
+    // left/right (duplicating mono). Files shorter than a crop are zero-padded.
+    // The crop choice depends only on the sampler's seed and call sequence.
+    Batch sample(uint32_t batch, uint32_t frames, uint16_t channels = 1, unsigned threads = 0)
+    {
+      Batch result;
+      channels = channels == 2 ? 2 : 1;
+      result.batch = batch;
+      result.channels = channels;
+      result.frames = frames;
+      result.data.assign(static_cast<size_t>(batch) * channels * frames, 0.0f);
+      if (totalFrames_ == 0)
+        return result;
+      std::uniform_int_distribution<uint64_t> pick(0, totalFrames_ - 1);
+      for (uint32_t b = 0; b < batch; b++)
+      {
+        uint64_t global = pick(rng_);
+        uint32_t file = static_cast<uint32_t>(std::upper_bound(cumulative_.begin(), cumulative_.end(), global) - cumulative_.begin());
+        uint32_t length = files_[file].info.num_samples;
+        uint32_t start = 0;
+        if (length > frames)
+          start = std::uniform_int_distribution<uint32_t>(0, length - frames)(rng_);
+        result.files.push_back(file);
+        result.starts.push_back(start);
+      }
+      std::atomic<bool> ok(true);
+      auto read = [&](size_t b)
+      {
+        if (!readCrop(result, b))
+          ok = false;
+      };
+      detail::parallelFor(batch, threads, read);
+      if (!ok)
+        std::cerr << "Some crops could not be read." << std::endl;
+      return result;
+    }
+
+    void seed(uint64_t value) { rng_.seed(value); }
+
+  private:
+    void buildWeights()
+    {
+      cumulative_.clear();
+      totalFrames_ = 0;
+      for (const File &f : files_)
+      {
+        totalFrames_ += f.info.num_samples;
+        cumulative_.push_back(totalFrames_);
+      }
+      handles_.clear();
+      handles_.resize(files_.size());
+      for (auto &handle : handles_)
+        handle.reset(new Handle);
+    }
+
+    // The file's descriptor, opened on first use; nullptr if it can't be opened.
+    detail::RandomAccessFile *fileFor(uint32_t index) const
+    {
+      Handle &handle = *handles_[index];
+      // A crop is one read; read-ahead past it would only evict other pages.
+      std::call_once(handle.once, [&]
+                     { handle.ok = handle.file.open(files_[index].path, AccessPattern::Random); });
+      return handle.ok ? &handle.file : nullptr;
+    }
+
+    bool readCrop(Batch &batch, size_t b) const
+    {
+      const File &f = files_[batch.files[b]];
+      uint32_t count = std::min(batch.frames, f.info.num_samples - batch.starts[b]);
+      std::vector<char> bytes(static_cast<size_t>(count) * f.info.block_align);
+      detail::RandomAccessFile *file = fileFor(batch.files[b]);
+      if (!file ||
+          !file->readAt(f.info.data_offset + static_cast<uint64_t>(batch.starts[b]) * f.info.block_align, bytes.data(), bytes.size()))
+        return false;
+      float *out = batch.data.data() + b * batch.channels * batch.frames;
+      return detail::dispatchFormat(f.info.bits_per_sample, [&](auto type)
+                                    { convertCrop<decltype(type)>(bytes.data(), count, f.info, batch, out); });
+    }
+
+    // Converts interleaved frames to float, mixed down or split into left/right.
+    template <typename T>
+    static void convertCrop(const char *bytes, uint32_t count, const WavInfo &info, const Batch &batch, float *out)
+    {
+      const size_t rightOffset = info.num_channels >= 2 ? sizeof(T) : 0;
+      for (uint32_t i = 0; i < count; i++)
+      {
+        const char *frame = bytes + static_cast<size_t>(i) * info.block_align;
+        T left, right;
+        std::memcpy(&left, frame, sizeof(T));
+        std::memcpy(&right, frame + rightOffset, sizeof(T));
+        if (batch.channels == 1)
+        {
+          out[i] = 0.5f * (detail::sampleToFloat(left) + detail::sampleToFloat(right));
+        }
+        else
+        {
+          out[i] = detail::sampleToFloat(left);
+          out[batch.frames + i] = detail::sampleToFloat(right);
+        }
+      }
+    }
+
+    struct Handle
+    {
+      std::once_flag once;
+      detail::RandomAccessFile file;
+      bool ok = false;
+    };
+
+    std::vector<File> files_;
+    std::vector<uint64_t> cumulative_; // running frame totals, for weighted picks
+    std::vector<std::unique_ptr<Handle>> handles_;
+    uint64_t totalFrames_ = 0;
+    std::mt19937_64 rng_{0};
+  };
+
+  //------------------------------------------------------------------------------
+  // Augmenter<T>: Randomized batch augmentation (speed, reverb, noise, gain).
+  //------------------------------------------------------------------------------
+  struct AugmentOptions
+  {
+    double speed_probability = 0.5;
+    std::vector<double> speeds = {0.9, 1.1}; // picked uniformly; changes tempo and pitch
+    double reverb_probability = 0.3;         // needs impulse responses
+    double noise_probability = 0.5;          // needs noise clips
+    double snr_db_min = 5.0;
+    double snr_db_max = 20.0;
+    double gain_db_min = -6.0;
+    double gain_db_max = 6.0;
+  };
+
+  // Applies, per clip and in this order: speed perturbation (resample and
+  // relabel, as in Kaldi), convolution with a random impulse response, noise
+  // mixed at a random SNR, and a random gain. Clip i of the n-th apply() call
+  // draws from its own generator seeded from (seed, n, i), so results do not
+  // depend on the thread count.
+  template <typename T>
+  class Augmenter
+  {
+  public:
+    explicit Augmenter(const AugmentOptions &options = AugmentOptions(), uint64_t seed = 0)
+        : options_(options), seed_(seed) {}
+
+    // Noise sources; a random excerpt (looped if short) is mixed into each clip.
+    void setNoises(std::vector<SharedWavData<T>> noises) { noises_ = std::move(noises); }
+
+    // Impulse responses (first channel used), normalized to unit energy so
+    // reverberation keeps roughly the dry signal's level.
+    void setImpulseResponses(const std::vector<WavData<T>> &responses)
+    {
+      irs_.clear();
+      for (const WavData<T> &ir : responses)
+      {
+        std::vector<float> taps(ir.num_samples);
+        double energy = 0.0;
+        for (uint32_t i = 0; i < ir.num_samples; i++)
+        {
+          taps[i] = detail::sampleToFloat(ir.channel1[i]);
+          energy += static_cast<double>(taps[i]) * taps[i];
+        }
+        if (energy > 0.0)
+        {
+          const float scale = static_cast<float>(1.0 / std::sqrt(energy));
+          for (float &t : taps)
+            t *= scale;
+        }
+        if (!taps.empty())
+          irs_.push_back(std::move(taps));
+      }
+    }
+
+    // Augments every clip of the batch in place on `threads` workers.
+    void apply(std::vector<WavData<T>> &batch, unsigned threads = 0)
+    {
+      uint64_t call = calls_++;
+      auto augmentClip = [&](size_t i)
+      {
+        // splitmix64-style mixing of (seed, call, clip) into an independent seed.
+        uint64_t z = seed_ + 0x9E3779B97F4A7C15ull * (call * 0x100000001B3ull + i + 1);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        std::mt19937_64 rng(z ^ (z >> 31));
+        augment(batch[i], rng);
+      };
+      detail::parallelFor(batch.size(), threads, augmentClip);
+    }
+
+  private:
+    void augment(WavData<T> &clip, std::mt19937_64 &rng) const
+    {
+      std::uniform_real_distribution<double> unit(0.0, 1.0);
+      if (!options_.speeds.empty() && unit(rng) < options_.speed_probability)
+      {
+        double speed = options_.speeds[std::uniform_int_distribution<size_t>(0, options_.speeds.size() - 1)(rng)];
+        uint32_t rate = clip.sample_rate;
+        clip = resample(clip, static_cast<uint32_t>(std::lround(rate / speed)));
+        clip.sample_rate = rate;
+      }
+      const uint16_t channels = clip.num_channels == 2 ? 2 : 1;
+      const uint32_t n = clip.num_samples;
+      std::vector<float> samples[2];
+      for (uint16_t c = 0; c < channels; c++)
+      {
+        const std::vector<T> &src = c == 0 ? clip.channel1 : clip.channel2;
+        samples[c].resize(n);
+        for (uint32_t i = 0; i < n; i++)
+          samples[c][i] = detail::sampleToFloat(src[i]);
+      }
+      if (!irs_.empty() && unit(rng) < options_.reverb_probability)
+      {
+        const std::vector<float> &ir = irs_[std::uniform_int_distribution<size_t>(0, irs_.size() - 1)(rng)];
+        for (uint16_t c = 0; c < channels; c++)
+          convolve(samples[c], ir);
+      }
+      if (!noises_.empty() && n > 0 && unit(rng) < options_.noise_probability)
+      {
+        const SharedWavData<T> &noise = noises_[std::uniform_int_distribution<size_t>(0, noises_.size() - 1)(rng)];
+        double snrDb = options_.snr_db_min + (options_.snr_db_max - options_.snr_db_min) * unit(rng);
+        if (noise.num_samples > 0)
+        {
+          uint32_t offset = std::uniform_int_distribution<uint32_t>(0, noise.num_samples - 1)(rng);
+          const std::vector<T> &src = noise.channel(0);
+          std::vector<float> excerpt(n);
+          for (uint32_t i = 0; i < n; i++)
+            excerpt[i] = detail::sampleToFloat(src[(offset + static_cast<uint64_t>(i)) % noise.num_samples]);
+          double signalPower = 0.0, noisePower = 0.0;
+          for (uint16_t c = 0; c < channels; c++)
+            signalPower += detail::dotProduct(samples[c].data(), samples[c].data(), n);
+          signalPower /= channels;
+          noisePower = detail::dotProduct(excerpt.data(), excerpt.data(), n);
+          if (noisePower > 0.0 && signalPower > 0.0)
+          {
+            float scale = static_cast<float>(std::sqrt(signalPower / (noisePower * std::pow(10.0, snrDb / 10.0))));
+            for (uint16_t c = 0; c < channels; c++)
+              for (uint32_t i = 0; i < n; i++)
+                samples[c][i] += scale * excerpt[i];
+          }
+        }
+      }
+      double gainDb = options_.gain_db_min + (options_.gain_db_max - options_.gain_db_min) * unit(rng);
+      float gain = static_cast<float>(std::pow(10.0, gainDb / 20.0));
+      for (uint16_t c = 0; c < channels; c++)
+      {
+        std::vector<T> &dest = c == 0 ? clip.channel1 : clip.channel2;
+        for (uint32_t i = 0; i < n; i++)
+          dest[i] = detail::floatToSample<T>(samples[c][i] * gain);
+      }
+    }
+
+    // FFT convolution, truncated to the input length.
+    static void convolve(std::vector<float> &signal, const std::vector<float> &ir)
+    {
+      if (signal.empty())
+        return;
+      FftPlan plan(FftPlan::nextPowerOfTwo(static_cast<uint32_t>(signal.size() + ir.size() - 1)));
+      std::vector<std::complex<float>> a(plan.size()), b(plan.size());
+      for (size_t i = 0; i < signal.size(); i++)
+        a[i] = signal[i];
+      for (size_t i = 0; i < ir.size(); i++)
+        b[i] = ir[i];
+      plan.transform(a.data());
+      plan.transform(b.data());
+      for (uint32_t k = 0; k < plan.size(); k++)
+        a[k] *= b[k];
+      plan.transform(a.data(), true);
+      const float scale = 1.0f / plan.size();
+      for (size_t i = 0; i < signal.size(); i++)
+        signal[i] = a[i].real() * scale;
+    }
+
+    AugmentOptions options_;
+    uint64_t seed_;
+    uint64_t calls_ = 0;
+    std::vector<SharedWavData<T>> noises_;
+    std::vector<std::vector<float>> irs_;
+  };
+
+  //------------------------------------------------------------------------------
+  // NumPy .npy export and memory-mapped import.
+  //------------------------------------------------------------------------------
+  enum class NpyLayout
+  {
+    ChannelsFirst, // shape (channels, frames): the planar WavData layout
+    FramesFirst    // shape (frames, channels): the interleaved WAV layout
+  };
+
+  namespace detail
+  {
+    template <typename T>
+    const char *npyDescr()
+    {
+      if (std::is_same<T, float>::value)
+        return "<f4";
+      if (std::is_same<T, uint8_t>::value)
+        return "|u1";
+      if (std::is_same<T, int16_t>::value)
+        return "<i2";
+      if (std::is_same<T, int32_t>::value)
+        return "<i4";
+      return nullptr;
+    }
+
+    // The .npy version 1.0 preamble and header dict, padded to 64 bytes.
+    inline std::string npyHeader(const char *descr, const std::vector<size_t> &shape)
+    {
+      std::string dict = std::string("{'descr': '") + descr + "', 'fortran_order': False, 'shape': (";
+      for (size_t d = 0; d < shape.size(); d++)
+        dict += std::to_string(shape[d]) + (shape.size() == 1 || d + 1 < shape.size() ? ", " : "");
+      dict += "), }";
+      size_t total = 10 + dict.size() + 1;
+      dict.append((64 - total % 64) % 64, ' ');
+      dict += '\n';
+      std::string header("\x93NUMPY\x01\x00", 8);
+      uint16_t length = static_cast<uint16_t>(dict.size());
+      header.append(reinterpret_cast<const char *>(&length), sizeof(length));
+      return header + dict;
+    }
+
+    // Converts up to two strided channels into a contiguous block of Out.
+    template <typename T, typename Out>
+    void convertBlock(const WavView<T> &v, uint32_t start, uint32_t count, NpyLayout layout, bool normalize, Out *out)
+    {
+      const uint16_t channels = v.num_channels == 2 ? 2 : 1;
+      for (uint16_t c = 0; c < channels; c++)
+        for (uint32_t i = 0; i < count; i++)
+        {
+          T s = v.sample(c, start + i);
+          Out value;
+          if constexpr (std::is_same<Out, float>::value)
+            value = normalize ? sampleToFloat(s) : static_cast<float>(s);
+          else
+            value = s;
+          size_t index = layout == NpyLayout::ChannelsFirst ? static_cast<size_t>(c) * count + i
+                                                            : static_cast<size_t>(i) * channels + c;
+          out[index] = value;
+        }
+    }
+  } // namespace detail
+
+  // Writes a clip as a 2-D .npy array. Without normalization the samples keep
+  // their type, and when the requested layout matches the view's memory
+  // (planar channels-first, or interleaved frames-first) the existing buffers
+  // are written directly with one writev(). With normalize, samples become
+  // float32 in [-1, 1).
+  template <typename T>
+  bool saveNpy(const WavView<T> &clip, const std::string &filePath, NpyLayout layout = NpyLayout::ChannelsFirst,
+               bool normalize = false)
+  {
+    const uint16_t channels = clip.num_channels == 2 ? 2 : 1;
+    const size_t frames = clip.num_samples;
+    std::vector<size_t> shape = layout == NpyLayout::ChannelsFirst ? std::vector<size_t>{channels, frames}
+                                                                   : std::vector<size_t>{frames, channels};
+    const char *descr = normalize ? "<f4" : detail::npyDescr<T>();
+    if (!descr)
+    {
+      std::cerr << "No .npy dtype for this sample type." << std::endl;
+      return false;
+    }
+    std::string header = detail::npyHeader(descr, shape);
+    if (!normalize)
+    {
+      if (layout == NpyLayout::ChannelsFirst && (clip.stride == 1 || frames <= 1))
+      {
+        std::vector<std::pair<const char *, size_t>> buffers = {{header.data(), header.size()},
+                                                                {reinterpret_cast<const char *>(clip.channel1), frames * sizeof(T)}};
+        if (channels == 2)
+          buffers.push_back({reinterpret_cast<const char *>(clip.channel2), frames * sizeof(T)});
+        return detail::writeBuffers(filePath, buffers);
+      }
+      if (layout == NpyLayout::FramesFirst && clip.stride == channels &&
+          (channels == 1 || clip.channel2 == clip.channel1 + 1))
+        return detail::writeBuffers(filePath, {{header.data(), header.size()},
+                                               {reinterpret_cast<const char *>(clip.channel1), frames * channels * sizeof(T)}});
+    }
+    // Layout or type differs from memory: convert once into a contiguous buffer.
+    std::vector<char> body;
+    if (normalize)
+    {
+      body.resize(frames * channels * sizeof(float));
+      detail::convertBlock(clip, 0, clip.num_samples, layout, true, reinterpret_cast<float *>(body.data()));
     }
-    return output;
+    else
+    {
+      body.resize(frames * channels * sizeof(T));
+      detail::convertBlock(clip, 0, clip.num_samples, layout, false, reinterpret_cast<T *>(body.data()));
+    }
+    return detail::writeBuffers(filePath, {{header.data(), header.size()}, {body.data(), body.size()}});
+  }
+
+  template <typename T>
+  bool saveNpy(const WavData<T> &clip, const std::string &filePath, NpyLayout layout = NpyLayout::ChannelsFirst,
+               bool normalize = false)
+  {
+    return saveNpy(clip.view(), filePath, layout, normalize);
+  }
+
+  // Writes equally long clips as one 3-D array, (batch, channels, frames) or
+  // (batch, frames, channels). Planar unnormalized clips are written straight
+  // from their channel buffers in a single writev().
+  template <typename T>
+  bool saveNpy(const std::vector<WavView<T>> &clips, const std::string &filePath,
+               NpyLayout layout = NpyLayout::ChannelsFirst, bool normalize = false)
+  {
+    if (clips.empty())
+    {
+      std::cerr << "No clips to save." << std::endl;
+      return false;
+    }
+    const uint16_t channels = clips.front().num_channels == 2 ? 2 : 1;
+    const size_t frames = clips.front().num_samples;
+    for (const WavView<T> &clip : clips)
+    {
+      if (clip.num_samples != frames || (clip.num_channels == 2 ? 2 : 1) != channels)
+      {
+        std::cerr << "All clips in an .npy batch must have the same shape." << std::endl;
+        return false;
+      }
+    }
+    std::vector<size_t> shape = layout == NpyLayout::ChannelsFirst ? std::vector<size_t>{clips.size(), channels, frames}
+                                                                   : std::vector<size_t>{clips.size(), frames, channels};
+    const char *descr = normalize ? "<f4" : detail::npyDescr<T>();
+    if (!descr)
+    {
+      std::cerr << "No .npy dtype for this sample type." << std::endl;
+      return false;
+    }
+    std::string header = detail::npyHeader(descr, shape);
+    std::vector<std::pair<const char *, size_t>> buffers = {{header.data(), header.size()}};
+    bool direct = !normalize && layout == NpyLayout::ChannelsFirst;
+    for (const WavView<T> &clip : clips)
+      direct = direct && (clip.stride == 1 || frames <= 1);
+    if (direct)
+    {
+      for (const WavView<T> &clip : clips)
+      {
+        buffers.push_back({reinterpret_cast<const char *>(clip.channel1), frames * sizeof(T)});
+        if (channels == 2)
+          buffers.push_back({reinterpret_cast<const char *>(clip.channel2), frames * sizeof(T)});
+      }
+      return detail::writeBuffers(filePath, buffers);
+    }
+    const size_t clipBytes = frames * channels * (normalize ? sizeof(float) : sizeof(T));
+    std::vector<char> body(clipBytes * clips.size());
+    for (size_t b = 0; b < clips.size(); b++)
+    {
+      char *out = body.data() + b * clipBytes;
+      if (normalize)
+        detail::convertBlock(clips[b], 0, clips[b].num_samples, layout, true, reinterpret_cast<float *>(out));
+      else
+        detail::convertBlock(clips[b], 0, clips[b].num_samples, layout, false, reinterpret_cast<T *>(out));
+    }
+    buffers.push_back({body.data(), body.size()});
+    return detail::writeBuffers(filePath, buffers);
+  }
+
+  // Writes a feature batch as float32 (batch, frames, dims).
+  inline bool saveNpy(const FeatureBatch &batch, const std::string &filePath)
+  {
+    std::string header = detail::npyHeader("<f4", {batch.batch, batch.frames, batch.dims});
+    return detail::writeBuffers(filePath, {{header.data(), header.size()},
+                                           {reinterpret_cast<const char *>(batch.data.data()), batch.data.size() * sizeof(float)}});
+  }
+
+  // A memory-mapped .npy array (C order only).
+  class NpyArray
+  {
+  public:
+    bool open(const std::string &filePath, AccessPattern pattern = AccessPattern::Normal)
+    {
+      if (!map_.open(filePath, pattern))
+        return false;
+      const char *base = map_.data();
+      if (map_.size() < 10 || std::memcmp(base, "\x93NUMPY", 6) != 0)
+      {
+        std::cerr << "Not an .npy file: " << filePath << std::endl;
+        map_.close();
+        return false;
+      }
+      uint8_t major = static_cast<uint8_t>(base[6]);
+      // Version 1 stores the header length in 2 bytes, later versions in 4.
+      const size_t preamble = major == 1 ? 10 : 12;
+      size_t headerLength = 0;
+      if (map_.size() >= preamble && major == 1)
+      {
+        uint16_t length;
+        std::memcpy(&length, base + 8, sizeof(length));
+        headerLength = length;
+      }
+      else if (map_.size() >= preamble)
+      {
+        uint32_t length;
+        std::memcpy(&length, base + 8, sizeof(length));
+        headerLength = length;
+      }
+      if (map_.size() < preamble || preamble + headerLength > map_.size())
+      {
+        std::cerr << "Truncated .npy header: " << filePath << std::endl;
+        map_.close();
+        return false;
+      }
+      std::string dict(base + preamble, headerLength);
+      if (!parseHeader(dict))
+      {
+        std::cerr << "Unsupported .npy header: " << dict << std::endl;
+        map_.close();
+        return false;
+      }
+      offset_ = preamble + headerLength;
+      size_t count = 1;
+      bool overflow = false;
+      for (size_t d : shape_)
+      {
+        overflow = overflow || (d != 0 && count > std::numeric_limits<size_t>::max() / d);
+        count *= d;
+      }
+      if (overflow || count > (map_.size() - offset_) / itemSize_)
+      {
+        std::cerr << "Truncated .npy data: " << filePath << std::endl;
+        map_.close();
+        return false;
+      }
+      return true;
+    }
+
+    const std::string &descr() const { return descr_; }
+    const std::vector<size_t> &shape() const { return shape_; }
+
+    // Pointer to the mapped elements; T must match descr() or nullptr is returned.
+    template <typename T>
+    const T *data() const
+    {
+      const char *expected = detail::npyDescr<T>();
+      if (!expected || descr_ != expected)
+        return nullptr;
+      return reinterpret_cast<const T *>(map_.data() + offset_);
+    }
+
+    // Zero-copy view of a (channels, frames) array with one or two channels.
+    template <typename T>
+    WavView<T> view(uint32_t sample_rate) const
+    {
+      WavView<T> v;
+      const T *samples = data<T>();
+      if (!samples || shape_.size() != 2 || shape_[0] < 1 || shape_[0] > 2)
+        return v;
+      v.sample_rate = sample_rate;
+      v.num_channels = static_cast<uint16_t>(shape_[0]);
+      v.bits_per_sample = sizeof(T) * 8;
+      v.num_samples = static_cast<uint32_t>(shape_[1]);
+      v.channel1 = samples;
+      if (v.num_channels == 2)
+        v.channel2 = samples + shape_[1];
+      return v;
+    }
+
+  private:
+    bool parseHeader(const std::string &dict)
+    {
+      // Malformed headers make this return false rather than throw.
+      auto valueAfter = [&](const char *key) -> size_t
+      {
+        size_t pos = dict.find(key);
+        if (pos != std::string::npos)
+          pos = dict.find(':', pos);
+        return pos == std::string::npos ? pos : dict.find_first_not_of(' ', pos + 1);
+      };
+      size_t d = valueAfter("'descr'");
+      size_t f = valueAfter("'fortran_order'");
+      size_t s = valueAfter("'shape'");
+      if (d == std::string::npos || f == std::string::npos || s == std::string::npos)
+        return false;
+      size_t q0 = dict.find('\'', d);
+      size_t q1 = q0 == std::string::npos ? q0 : dict.find('\'', q0 + 1);
+      if (q1 == std::string::npos)
+        return false;
+      descr_ = dict.substr(q0 + 1, q1 - q0 - 1);
+      if (dict.compare(f, 5, "False") != 0)
+        return false;
+      size_t open = dict.find('(', s);
+      size_t close = open == std::string::npos ? open : dict.find(')', open);
+      if (close == std::string::npos)
+        return false;
+      shape_.clear();
+      std::istringstream dims(dict.substr(open + 1, close - open - 1));
+      std::string dim;
+      while (std::getline(dims, dim, ','))
+      {
+        size_t first = dim.find_first_not_of(' ');
+        if (first == std::string::npos)
+          continue; // trailing comma of a 1-D shape
+        const char *begin = dim.c_str() + first;
+        if (*begin < '0' || *begin > '9')
+          return false;
+        char *end = nullptr;
+        errno = 0;
+        unsigned long long value = std::strtoull(begin, &end, 10);
+        if (errno == ERANGE || value > std::numeric_limits<size_t>::max() ||
+            dim.find_first_not_of(' ', static_cast<size_t>(end - dim.c_str())) != std::string::npos)
+          return false;
+        shape_.push_back(static_cast<size_t>(value));
+      }
+      if (descr_ == "|u1" || descr_ == "|i1")
+        itemSize_ = 1;
+      else if (descr_ == "<i2")
+        itemSize_ = 2;
+      else if (descr_ == "<i4" || descr_ == "<f4")
+        itemSize_ = 4;
+      else if (descr_ == "<f8" || descr_ == "<i8")
+        itemSize_ = 8;
+      else
+        return false;
+      return true;
+    }
+
+    detail::MappedFile map_;
+    std::string descr_;
+    std::vector<size_t> shape_;
+    size_t itemSize_ = 0;
+    size_t offset_ = 0;
+  };
+
+  //------------------------------------------------------------------------------
+  // DiskCache: Persistent cache of transformed audio, keyed by source identity.
+  //------------------------------------------------------------------------------
+  // Each entry is a one-clip bundle holding planar samples of the transform's
+  // output, named after a hash of (path, size, mtime, inode, params). Hits
+  // memory-map the entry and touch its mtime; inserts evict the least recently
+  // used entries until the directory is within maxBytes. Entries are written
+  // under a temporary name and renamed, so concurrent jobs can share a cache;
+  // temporary files left by a crashed writer are removed after an hour.
+  class DiskCache
+  {
+  public:
+    // A mapped cache entry; the view stays valid while this object lives.
+    template <typename T>
+    class Entry
+    {
+    public:
+      WavView<T> view() const { return reader_.planarView<T>(0); }
+      WavData<T> toWavData() const { return WavData<T>(view()); }
+
+    private:
+      friend class DiskCache;
+      BundleReader reader_;
+    };
+
+    DiskCache(const std::string &directory, uint64_t maxBytes) : directory_(directory), maxBytes_(maxBytes)
+    {
+      std::error_code ec;
+      std::filesystem::create_directories(directory_, ec);
+      evict();
+    }
+
+    // Returns the cached result of transform(sourcePath) for these params, or
+    // runs transform (a callable returning WavData<T>) and stores its result.
+    // params must describe everything the transform depends on besides the file.
+    // A result with no samples or channels is taken as failure and not stored.
+    template <typename T, typename F>
+    bool getOrCompute(const std::string &sourcePath, const std::string &params, F &&transform, Entry<T> &entry)
+    {
+      std::string key;
+      if (!makeKey(sourcePath, params, key))
+      {
+        std::cerr << "Couldn't stat file: " << sourcePath << std::endl;
+        return false;
+      }
+      std::string path = entryPath(key);
+      if (open(path, key, entry))
+      {
+        touch(path);
+        return true;
+      }
+      WavData<T> result = transform(sourcePath);
+      if (result.num_samples == 0 || result.num_channels == 0)
+      {
+        std::cerr << "Transform produced no audio for: " << sourcePath << std::endl;
+        return false;
+      }
+      std::string temp = path + ".tmp." + tempSuffix();
+      {
+        BundleWriter writer;
+        if (!writer.open(temp) || !writer.addPlanar(key, result.view()) || !writer.finish())
+        {
+          std::error_code ec;
+          std::filesystem::remove(temp, ec);
+          return false;
+        }
+      }
+      std::error_code ec;
+      std::filesystem::rename(temp, path, ec);
+      if (ec)
+      {
+        std::cerr << "Couldn't store cache entry: " << path << std::endl;
+        std::filesystem::remove(temp, ec);
+        return false;
+      }
+      evict(path);
+      return open(path, key, entry);
+    }
+
+    // Deletes least recently used entries until the cache fits in maxBytes,
+    // never deleting `keep`. Temporary files count towards the size, and are
+    // deleted once stale.
+    void evict(const std::string &keep = std::string())
+    {
+      const auto staleBefore = std::filesystem::file_time_type::clock::now() - std::chrono::hours(1);
+      struct Item
+      {
+        std::filesystem::file_time_type used;
+        uint64_t size;
+        std::filesystem::path path;
+      };
+      std::vector<Item> items;
+      uint64_t total = 0;
+      std::error_code ec;
+      for (const auto &file : std::filesystem::directory_iterator(directory_, ec))
+      {
+        const bool temp = file.path().filename().string().find(".wlbd.tmp.") != std::string::npos;
+        if (!temp && file.path().extension() != ".wlbd")
+          continue;
+        Item item{file.last_write_time(ec), file.file_size(ec), file.path()};
+        if (ec)
+          continue;
+        if (temp && item.used < staleBefore)
+          std::filesystem::remove(item.path, ec);
+        else
+          total += item.size;
+        if (!temp)
+          items.push_back(item);
+      }
+      if (total <= maxBytes_)
+        return;
+      std::sort(items.begin(), items.end(), [](const Item &a, const Item &b)
+                { return a.used < b.used; });
+      for (const Item &item : items)
+      {
+        if (total <= maxBytes_)
+          break;
+        if (item.path == keep)
+          continue;
+        if (std::filesystem::remove(item.path, ec))
+          total -= item.size;
+      }
+    }
+
+  private:
+    bool makeKey(const std::string &sourcePath, const std::string &params, std::string &key) const
+    {
+      detail::FileIdentity id;
+      if (!detail::fileIdentity(sourcePath, id))
+        return false;
+      std::error_code ec;
+      std::filesystem::path absolute = std::filesystem::absolute(sourcePath, ec);
+      key = (ec ? sourcePath : absolute.string()) + '\n' + std::to_string(id.size) + '\n' +
+            std::to_string(id.mtime_ns) + '\n' + std::to_string(id.inode) + '\n' + params;
+      return true;
+    }
+
+    std::string entryPath(const std::string &key) const
+    {
+      char name[32];
+      std::snprintf(name, sizeof(name), "%016llx.wlbd", static_cast<unsigned long long>(detail::hashBytes(key)));
+      return (std::filesystem::path(directory_) / name).string();
+    }
+
+    // Unique per process and thread, so jobs sharing the directory never
+    // write the same temporary file.
+    static std::string tempSuffix()
+    {
+#ifdef WAVLIB_POSIX
+      std::string process = std::to_string(getpid());
+#else
+      static const std::string process = std::to_string(std::random_device()());
+#endif
+      return process + '.' + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    }
+
+    template <typename T>
+    static bool open(const std::string &path, const std::string &key, Entry<T> &entry)
+    {
+      std::error_code ec;
+      if (!std::filesystem::exists(path, ec))
+        return false;
+      // A hash collision or a foreign file reads as a miss.
+      return entry.reader_.open(path) && entry.reader_.size() == 1 && entry.reader_.name(0) == key &&
+             entry.reader_.entry(0).layout == BundleEntry::kPlanarPcm &&
+             entry.reader_.entry(0).bits_per_sample == sizeof(T) * 8;
+    }
+
+    static void touch(const std::string &path)
+    {
+      std::error_code ec;
+      std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+    }
+
+    std::string directory_;
+    uint64_t maxBytes_;
+  };
+
+  //------------------------------------------------------------------------------
+  // WavDataCache<T>: Thread-safe in-memory LRU cache of decoded files.
+  //------------------------------------------------------------------------------
+  // Entries are keyed by path and checked against the file's size and mtime,
+  // so a rewritten file is a miss and its new contents replace the old entry.
+  // The key space is split over shards with their own lock; the byte budget
+  // is shared. An insert evicts the least recently used entries of its own
+  // shard first, then of the others, so eviction order is LRU per shard.
+  // Hits return a SharedWavData that shares the cached buffers; callers that
+  // mutate it get a private copy (copy-on-write).
+  template <typename T>
+  class WavDataCache
+  {
+  public:
+    explicit WavDataCache(uint64_t maxBytes, size_t shardCount = 16)
+        : shards_(std::max<size_t>(1, shardCount)), maxBytes_(maxBytes) {}
+
+    WavDataCache(const WavDataCache &) = delete;
+    WavDataCache &operator=(const WavDataCache &) = delete;
+
+    // Returns the decoded file from the cache, reading it on a miss. Two
+    // threads missing on the same file at once may both read it. Files larger
+    // than the whole budget are returned but not cached.
+    bool get(const std::string &filePath, SharedWavData<T> &out)
+    {
+      detail::FileIdentity id;
+      if (!detail::fileIdentity(filePath, id))
+      {
+        std::cerr << "Couldn't open file: " << filePath << std::endl;
+        return false;
+      }
+      const size_t s = std::hash<std::string>()(filePath) % shards_.size();
+      Shard &shard = shards_[s];
+      {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(filePath);
+        if (it != shard.index.end() && it->second->size == id.size && it->second->mtime_ns == id.mtime_ns)
+        {
+          shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+          out = it->second->data;
+          hits_++;
+          return true;
+        }
+      }
+      misses_++;
+      WavFile file;
+      if (!file.read(filePath))
+        return false;
+      if (file.bits_per_sample != sizeof(T) * 8)
+      {
+        std::cerr << "Bit depth mismatch: file has " << file.bits_per_sample
+                  << " bits, but T is " << (sizeof(T) * 8) << " bits." << std::endl;
+        return false;
+      }
+      SharedWavData<T> data{WavData<T>(file)};
+      uint64_t bytes = static_cast<uint64_t>(data.num_samples) * (data.num_channels == 2 ? 2 : 1) * sizeof(T);
+      out = data;
+      if (bytes > maxBytes_)
+        return true;
+      {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(filePath);
+        if (it != shard.index.end())
+        {
+          if (it->second->size == id.size && it->second->mtime_ns == id.mtime_ns)
+            return true; // another thread cached it first
+          erase(shard, it->second);
+        }
+        shard.lru.push_front(Node{filePath, id.size, id.mtime_ns, data, bytes});
+        shard.index[filePath] = shard.lru.begin();
+        shard.bytes += bytes;
+        total_ += bytes;
+        trim(shard, 1);
+      }
+      // Still over budget: take the rest from the other shards, one lock at a time.
+      for (size_t i = 1; i < shards_.size() && total_ > maxBytes_; i++)
+      {
+        Shard &other = shards_[(s + i) % shards_.size()];
+        std::lock_guard<std::mutex> lock(other.mutex);
+        trim(other, 0);
+      }
+      return true;
+    }
+
+    // Drops the entry for a path.
+    void invalidate(const std::string &filePath)
+    {
+      Shard &shard = shards_[std::hash<std::string>()(filePath) % shards_.size()];
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      auto it = shard.index.find(filePath);
+      if (it != shard.index.end())
+        erase(shard, it->second);
+    }
+
+    // Total bytes of samples currently cached.
+    uint64_t bytes() const { return total_; }
+
+    uint64_t hits() const { return hits_; }
+    uint64_t misses() const { return misses_; }
+
+  private:
+    struct Node
+    {
+      std::string path;
+      uint64_t size;
+      int64_t mtime_ns;
+      SharedWavData<T> data;
+      uint64_t bytes;
+    };
+
+    struct Shard
+    {
+      mutable std::mutex mutex;
+      std::list<Node> lru; // most recently used first
+      std::unordered_map<std::string, typename std::list<Node>::iterator> index;
+      uint64_t bytes = 0;
+    };
+
+    // Callers hold shard.mutex.
+    void erase(Shard &shard, typename std::list<Node>::iterator node)
+    {
+      shard.bytes -= node->bytes;
+      total_ -= node->bytes;
+      shard.index.erase(node->path);
+      shard.lru.erase(node);
+    }
+
+    // Evicts from the back of the shard while over budget, keeping its `keep`
+    // most recent entries. Callers hold shard.mutex.
+    void trim(Shard &shard, size_t keep)
+    {
+      while (total_ > maxBytes_ && shard.lru.size() > keep)
+        erase(shard, std::prev(shard.lru.end()));
+    }
+
+    std::vector<Shard> shards_;
+    const uint64_t maxBytes_;
+    std::atomic<uint64_t> total_{0};
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+  };
+
+
+  //------------------------------------------------------------------------------
+  // loadFiles: Loads many files concurrently, handing each to a consumer.
+  //------------------------------------------------------------------------------
+  // On Linux the open, statx, read and close of up to `depth` files at a time
+  // are queued on an io_uring, so the device sees a deep queue from a single
+  // thread; headers are parsed as reads complete. Elsewhere, or where
+  // io_uring is unavailable (old kernels, seccomp filters), `threads` workers
+  // (0 = hardware concurrency) call WavFile::read instead; if the ring fails
+  // partway, they load the files it hadn't finished.
+  namespace detail
+  {
+#ifdef WAVLIB_IO_URING
+    // The submission and completion rings of an io_uring, set up with the raw
+    // system calls.
+    class IoUring
+    {
+    public:
+      IoUring() = default;
+      IoUring(const IoUring &) = delete;
+      IoUring &operator=(const IoUring &) = delete;
+      ~IoUring()
+      {
+        if (sqes_)
+          ::munmap(sqes_, sqes_size_);
+        if (cq_ring_ && cq_ring_ != sq_ring_)
+          ::munmap(cq_ring_, cq_ring_size_);
+        if (sq_ring_)
+          ::munmap(sq_ring_, sq_ring_size_);
+        if (fd_ >= 0)
+          ::close(fd_);
+      }
+
+      bool init(unsigned entries)
+      {
+        struct io_uring_params p;
+        std::memset(&p, 0, sizeof(p));
+        fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &p));
+        if (fd_ < 0)
+          return false;
+        sq_ring_size_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_ring_size_ = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+        bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single)
+          sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+        sq_ring_ = map(sq_ring_size_, IORING_OFF_SQ_RING);
+        cq_ring_ = single ? sq_ring_ : map(cq_ring_size_, IORING_OFF_CQ_RING);
+        sqes_size_ = p.sq_entries * sizeof(struct io_uring_sqe);
+        sqes_ = map(sqes_size_, IORING_OFF_SQES);
+        if (!sq_ring_ || !cq_ring_ || !sqes_)
+          return false;
+        char *sq = static_cast<char *>(sq_ring_);
+        char *cq = static_cast<char *>(cq_ring_);
+        sq_head_ = reinterpret_cast<unsigned *>(sq + p.sq_off.head);
+        sq_tail_ = reinterpret_cast<unsigned *>(sq + p.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<unsigned *>(sq + p.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned *>(sq + p.sq_off.array);
+        cq_head_ = reinterpret_cast<unsigned *>(cq + p.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned *>(cq + p.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned *>(cq + p.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<struct io_uring_cqe *>(cq + p.cq_off.cqes);
+        entries_ = p.sq_entries;
+        tail_ = *sq_tail_;
+        return true;
+      }
+
+      // True if the kernel implements every opcode; kernels without
+      // IORING_REGISTER_PROBE (before 5.6) lack some of ours anyway.
+      bool supports(std::initializer_list<uint8_t> opcodes) const
+      {
+        const unsigned count = 256;
+        std::vector<char> buffer(sizeof(struct io_uring_probe) + count * sizeof(struct io_uring_probe_op), 0);
+        struct io_uring_probe *probe = reinterpret_cast<struct io_uring_probe *>(buffer.data());
+        if (::syscall(__NR_io_uring_register, fd_, IORING_REGISTER_PROBE, probe, count) < 0)
+          return false;
+        for (uint8_t op : opcodes)
+          if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED))
+            return false;
+        return true;
+      }
+
+      // Returns a cleared submission entry, or nullptr if the queue is full.
+      struct io_uring_sqe *prepare(uint64_t userData)
+      {
+        if (tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= entries_)
+          return nullptr;
+        unsigned index = tail_ & sq_mask_;
+        struct io_uring_sqe *sqe = static_cast<struct io_uring_sqe *>(sqes_) + index;
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->user_data = userData;
+        sq_array_[index] = index;
+        tail_++;
+        queued_++;
+        return sqe;
+      }
+
+      // Submits the prepared entries and waits for at least waitFor completions.
+      bool submit(unsigned waitFor)
+      {
+        __atomic_store_n(sq_tail_, tail_, __ATOMIC_RELEASE);
+        return enter(queued_, waitFor);
+      }
+
+      // Waits for a completion without submitting anything more.
+      bool wait() { return enter(0, 1); }
+
+      // Operations the kernel has taken but not yet completed.
+      unsigned inFlight() const { return inFlight_; }
+
+      // Calls fn(cqe) for each completion that has arrived.
+      template <typename F>
+      void drain(F &&fn)
+      {
+        unsigned head = *cq_head_;
+        unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++)
+        {
+          inFlight_--;
+          fn(cqes_[head & cq_mask_]);
+        }
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+      }
+
+    private:
+      bool enter(unsigned toSubmit, unsigned waitFor)
+      {
+        for (;;)
+        {
+          long n = ::syscall(__NR_io_uring_enter, fd_, toSubmit, waitFor, waitFor ? IORING_ENTER_GETEVENTS : 0,
+                             nullptr, 0);
+          if (n >= 0)
+          {
+            queued_ -= static_cast<unsigned>(n);
+            inFlight_ += static_cast<unsigned>(n);
+            return true;
+          }
+          if (errno != EINTR)
+            return false;
+        }
+      }
+
+      void *map(size_t size, uint64_t offset)
+      {
+        void *p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                         static_cast<off_t>(offset));
+        return p == MAP_FAILED ? nullptr : p;
+      }
+
+      int fd_ = -1;
+      void *sq_ring_ = nullptr;
+      void *cq_ring_ = nullptr;
+      void *sqes_ = nullptr;
+      size_t sq_ring_size_ = 0, cq_ring_size_ = 0, sqes_size_ = 0;
+      unsigned *sq_head_ = nullptr, *sq_tail_ = nullptr, *sq_array_ = nullptr;
+      unsigned *cq_head_ = nullptr, *cq_tail_ = nullptr;
+      unsigned sq_mask_ = 0, cq_mask_ = 0, entries_ = 0;
+      struct io_uring_cqe *cqes_ = nullptr;
+      unsigned tail_ = 0;     // local submission tail, published by submit()
+      unsigned queued_ = 0;   // prepared but not yet submitted
+      unsigned inFlight_ = 0; // submitted but not yet drained
+    };
+
+    // Runs the per-file state machine for loadFiles: open and statx in
+    // parallel, then reads until the file's size is in, then close. Any
+    // failure falls back to WavFile::read for that file, which retries it and
+    // reports the error. Sets handled[i] once path i has been consumed or
+    // reported. Returns false if the ring is missing an opcode or fails, so the
+    // caller can finish the unhandled paths with the thread pool. If the ring
+    // fails mid-run, operations already submitted are waited for before the
+    // slots they point into are freed.
+    template <typename F>
+    bool loadFilesUring(const std::vector<std::string> &paths, F &consume, unsigned depth, size_t &loaded,
+                        std::vector<char> &handled)
+    {
+      enum Op : uint64_t
+      {
+        kOpen,
+        kStatx,
+        kRead,
+        kClose
+      };
+      struct Slot
+      {
+        size_t index = 0;
+        int fd = -1;
+        unsigned pending = 0; // operations in flight
+        bool failed = false;
+        uint64_t size = 0, done = 0;
+        struct statx stat;
+        WavFile file;
+      };
+      depth = std::max(1u, depth);
+      IoUring ring;
+      if (!ring.init(2 * depth) || // each slot has at most two operations queued
+          !ring.supports({IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ, IORING_OP_CLOSE}))
+        return false;
+      std::vector<Slot> slots(std::min<size_t>(depth, paths.size()));
+      std::vector<size_t> idle;
+      for (size_t s = slots.size(); s-- > 0;)
+        idle.push_back(s);
+      size_t next = 0, active = 0;
+      bool broken = false, stopping = false;
+
+      auto tag = [](size_t s, Op op)
+      { return static_cast<uint64_t>(s) << 2 | op; };
+      auto queueRead = [&](size_t s)
+      {
+        Slot &slot = slots[s];
+        struct io_uring_sqe *sqe = ring.prepare(tag(s, kRead));
+        if (!sqe)
+        {
+          broken = true;
+          return;
+        }
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = slot.fd;
+        sqe->addr = reinterpret_cast<uint64_t>(slot.file.raw_data.data() + slot.done);
+        sqe->len = static_cast<uint32_t>(std::min<uint64_t>(slot.size - slot.done, 1u << 30));
+        sqe->off = slot.done;
+        slot.pending++;
+      };
+      auto queueClose = [&](size_t s)
+      {
+        struct io_uring_sqe *sqe = ring.prepare(tag(s, kClose));
+        if (!sqe)
+        {
+          broken = true;
+          return;
+        }
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->fd = slots[s].fd;
+        slots[s].fd = -1;
+        slots[s].pending++;
+      };
+      auto finish = [&](size_t s)
+      {
+        Slot &slot = slots[s];
+        if (slot.failed ? slot.file.read(paths[slot.index]) : slot.file.adoptBuffer(static_cast<size_t>(slot.size)))
+        {
+          consume(slot.index, slot.file);
+          loaded++;
+        }
+        handled[slot.index] = 1;
+        idle.push_back(s);
+        active--;
+      };
+      // Called whenever a slot's last operation in flight completes.
+      auto advance = [&](size_t s)
+      {
+        Slot &slot = slots[s];
+        if (slot.fd >= 0 && (slot.failed || slot.done == slot.size))
+          queueClose(s);
+        else if (slot.fd >= 0)
+          queueRead(s);
+        else
+          finish(s);
+      };
+      auto complete = [&](const struct io_uring_cqe &cqe)
+      {
+        size_t s = static_cast<size_t>(cqe.user_data >> 2);
+        Slot &slot = slots[s];
+        slot.pending--;
+        switch (cqe.user_data & 3)
+        {
+        case kOpen:
+          if (cqe.res >= 0)
+            slot.fd = cqe.res;
+          else
+            slot.failed = true;
+          break;
+        case kStatx:
+          if (cqe.res >= 0)
+          {
+            slot.size = slot.stat.stx_size;
+            slot.file.raw_data.resize(static_cast<size_t>(slot.size));
+          }
+          else
+            slot.failed = true;
+          break;
+        case kRead:
+          if (cqe.res > 0)
+            slot.done += static_cast<uint64_t>(cqe.res);
+          else if (cqe.res == 0)
+            slot.size = slot.done; // file shrank
+          else
+            slot.failed = true;
+          break;
+        }
+        if (slot.pending == 0 && !stopping)
+          advance(s);
+      };
+
+      while (!broken && (next < paths.size() || active > 0))
+      {
+        for (; next < paths.size() && !idle.empty(); next++)
+        {
+          size_t s = idle.back();
+          Slot &slot = slots[s];
+          struct io_uring_sqe *open = ring.prepare(tag(s, kOpen));
+          struct io_uring_sqe *stat = open ? ring.prepare(tag(s, kStatx)) : nullptr;
+          if (!stat)
+          {
+            broken = true;
+            break;
+          }
+          idle.pop_back();
+          active++;
+          slot.index = next;
+          slot.failed = false;
+          slot.size = slot.done = 0;
+          open->opcode = IORING_OP_OPENAT;
+          open->fd = AT_FDCWD;
+          open->addr = reinterpret_cast<uint64_t>(paths[next].c_str());
+          open->open_flags = O_RDONLY | O_CLOEXEC;
+          stat->opcode = IORING_OP_STATX;
+          stat->fd = AT_FDCWD;
+          stat->addr = reinterpret_cast<uint64_t>(paths[next].c_str());
+          stat->len = STATX_SIZE;
+          stat->off = reinterpret_cast<uint64_t>(&slot.stat);
+          slot.pending = 2;
+        }
+        if (broken || !ring.submit(1))
+          break;
+        ring.drain(complete);
+      }
+      if (!broken && next == paths.size() && active == 0)
+        return true;
+
+      // The ring failed: let submitted operations finish, since they write
+      // into the slots, then close whatever they left open.
+      stopping = true;
+      while (ring.inFlight() > 0 && ring.wait())
+        ring.drain(complete);
+      if (ring.inFlight() > 0)
+      {
+        // Closing the ring doesn't wait for requests the kernel has handed to
+        // its workers; they may still write into these buffers afterwards, so
+        // they are deliberately leaked rather than freed.
+        new std::vector<Slot>(std::move(slots));
+      }
+      else
+        for (Slot &slot : slots)
+          if (slot.fd >= 0)
+            ::close(slot.fd);
+      if (std::find(handled.begin(), handled.end(), 1) != handled.end())
+        std::cerr << "io_uring failed; loading the remaining files with threads." << std::endl;
+      return false;
+    }
+#endif
+  } // namespace detail
+
+  // Calls consume(index, file) for each path that loads, in completion order,
+  // where file is a WavFile& the consumer may move from. Calls are never
+  // concurrent. Returns the number of files loaded; failures are reported
+  // and skipped.
+  template <typename F>
+  size_t loadFiles(const std::vector<std::string> &paths, F &&consume, unsigned depth = 64, unsigned threads = 0)
+  {
+    size_t loaded = 0;
+    std::vector<char> handled(paths.size(), 0);
+#ifdef WAVLIB_IO_URING
+    if (detail::loadFilesUring(paths, consume, depth, loaded, handled))
+      return loaded;
+#else
+    (void)depth;
+#endif
+    std::mutex mutex;
+    auto load = [&](size_t i)
+    {
+      if (handled[i])
+        return;
+      WavFile file;
+      if (!file.read(paths[i]))
+        return;
+      std::lock_guard<std::mutex> lock(mutex);
+      consume(i, file);
+      loaded++;
+    };
+    detail::parallelFor(paths.size(), threads, load);
+    return loaded;
   }
 
 } // namespace wav